@@ -104,6 +104,11 @@ class Warp : public std::enable_shared_from_this<Warp> {
 		sIsGammaMode.compare_exchange_strong( exp, !(bool)sIsGammaMode );
 	};
 
+	//! Returns the number of meshes created by all warps, e.g. after a resize or a change of resolution.
+	static uint64_t getMeshRebuildCount() { return sMeshRebuilds; };
+	//! Returns the number of times all warps uploaded their mesh vertices after the control points changed.
+	static uint64_t getMeshUpdateCount() { return sMeshUpdates; };
+
 	//! Returns the type of the warp.
 	WarpType getType() const { return mType; };
 	//! Returns a shared pointer to this warp.
@@ -340,6 +345,10 @@ class Warp : public std::enable_shared_from_this<Warp> {
 
 	static const int MAX_NUM_CONTROL_POINTS = 1024;
 
+	//! Mesh statistics for all warps.
+	static std::atomic<uint64_t> sMeshRebuilds;
+	static std::atomic<uint64_t> sMeshUpdates;
+
   private:
 	ci::vec2 mOffset;
 
@@ -34,6 +34,8 @@ namespace ph {
 
 std::atomic<bool> Warp::sIsEditMode{ false };
 std::atomic<bool> Warp::sIsGammaMode{ false };
+std::atomic<uint64_t> Warp::sMeshRebuilds{ 0 };
+std::atomic<uint64_t> Warp::sMeshUpdates{ 0 };
 
 		Warp::Warp(WarpType type)
 			: mType(type)
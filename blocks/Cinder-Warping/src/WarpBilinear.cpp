@@ -453,6 +453,7 @@ void WarpBilinear::createMesh( int resolutionX, int resolutionY )
 
 	//
 	mIsDirty = true;
+	++sMeshRebuilds;
 }
 
 // Mapped buffer seems to be a *tiny* bit faster.
@@ -531,6 +532,7 @@ void WarpBilinear::updateMesh()
 	mBatch2DRect = gl::Batch::create( mVboMesh, mShader2DRect );
 
 	mIsDirty = false;
+	++sMeshUpdates;
 }
 
 vec2 WarpBilinear::getPoint( int col, int row ) const
@@ -38,12 +38,27 @@
 using namespace std;
 
 WebSocketClient::WebSocketClient()
+	: mOwnsIoService( true )
 {
 	mClient.clear_access_channels( websocketpp::log::alevel::all );
 	mClient.clear_error_channels( websocketpp::log::elevel::all );
 	
 	mClient.init_asio();
+	initHandlers();
+}
+
+WebSocketClient::WebSocketClient( asio::io_service* ioService )
+	: mOwnsIoService( false )
+{
+	mClient.clear_access_channels( websocketpp::log::alevel::all );
+	mClient.clear_error_channels( websocketpp::log::elevel::all );
 
+	mClient.init_asio( ioService );
+	initHandlers();
+}
+
+void WebSocketClient::initHandlers()
+{
 	mClient.set_close_handler(			bind( &WebSocketClient::onClose,		this, &mClient, std::placeholders::_1 ) );
 	mClient.set_fail_handler(			bind( &WebSocketClient::onFail,			this, &mClient, std::placeholders::_1 ) );
 	mClient.set_http_handler(			bind( &WebSocketClient::onHttp,			this, &mClient, std::placeholders::_1 ) );
@@ -59,7 +74,10 @@ WebSocketClient::WebSocketClient()
 
 WebSocketClient::~WebSocketClient()
 {
-	if ( !mClient.stopped() ) {
+	if ( !mOwnsIoService ) {
+		// the shared io_service keeps running for the other clients
+		disconnect();
+	} else if ( !mClient.stopped() ) {
 		disconnect();
 		mClient.stop();
 	}
@@ -104,7 +122,7 @@ void WebSocketClient::connect( const std::string& uri )
 void WebSocketClient::disconnect()
 {
 	websocketpp::lib::error_code err;
-	mClient.close( mHandle, websocketpp::close::status::going_away, "", err );
+	mClient.close( getHandle(), websocketpp::close::status::going_away, "", err );
 	if ( err ) {
 		if ( mFailEventHandler != nullptr ) {
 			mFailEventHandler( err.message() );
@@ -115,7 +133,9 @@ void WebSocketClient::disconnect()
 void WebSocketClient::ping( const string& msg )
 {
 	try {
-		mClient.get_con_from_hdl( mHandle )->ping( msg );
+		mClient.get_con_from_hdl( getHandle() )->ping( msg );
+		pingSent();
+		countOut( websocketpp::frame::opcode::PING, msg.size() );
 	} catch( ... ) {
 		if ( mFailEventHandler != nullptr ) {
 			mFailEventHandler( "Ping failed." );
@@ -128,6 +148,16 @@ void WebSocketClient::poll()
 	mClient.poll();
 }
 
+void WebSocketClient::run()
+{
+	mClient.run();
+}
+
+void WebSocketClient::stop()
+{
+	mClient.stop();
+}
+
 void WebSocketClient::write( const std::string& msg )
 {
 	if ( msg.empty() ) {
@@ -136,12 +166,13 @@ void WebSocketClient::write( const std::string& msg )
 		}
 	} else {
 		websocketpp::lib::error_code err;
-		mClient.send( mHandle, msg, websocketpp::frame::opcode::TEXT, err );
+		mClient.send( getHandle(), msg, websocketpp::frame::opcode::TEXT, err );
 		if ( err ) {
 			if ( mFailEventHandler != nullptr ) {
 				mFailEventHandler( err.message() );
 			}
 		} else {
+			countOut( websocketpp::frame::opcode::TEXT, msg.size() );
 			if ( mWriteEventHandler != nullptr ) {
 				mWriteEventHandler();
 			}
@@ -157,7 +188,7 @@ void WebSocketClient::write(void const * msg, size_t len)
 	}
 	else {
 		websocketpp::lib::error_code err;
-		mClient.send(mHandle,
+		mClient.send(getHandle(),
 			msg,
 			len,
 			websocketpp::frame::opcode::BINARY,
@@ -168,6 +199,7 @@ void WebSocketClient::write(void const * msg, size_t len)
 			}
 		}
 		else {
+			countOut(websocketpp::frame::opcode::BINARY, len);
 			if (mWriteEventHandler != nullptr) {
 				mWriteEventHandler();
 			}
@@ -180,7 +212,7 @@ void WebSocketClient::writeBinary(const void *ptr, size_t len)
 {
 	if (len > 0) {
 		websocketpp::lib::error_code err;
-		mClient.send(mHandle, ptr, len, websocketpp::frame::opcode::BINARY, err);
+		mClient.send(getHandle(), ptr, len, websocketpp::frame::opcode::BINARY, err);
 		if (err) {
 			if (mFailEventHandler != nullptr) {
 				mFailEventHandler(err.message());
@@ -194,6 +226,18 @@ void WebSocketClient::writeBinary(const void *ptr, size_t len)
 	}
 }*/
 
+WebSocketStats WebSocketClient::getStats() const
+{
+	WebSocketStats stats = WebSocketConnection::getStats();
+	websocketpp::lib::error_code err;
+	ConnectionRef con = const_cast<Client&>( mClient ).get_con_from_hdl( getHandle(), err );
+	if ( !err ) {
+		stats.sendQueueDepth	= con->get_send_queue_size();
+		stats.bufferedAmount	= con->get_buffered_amount();
+	}
+	return stats;
+}
+
 WebSocketClient::Client& WebSocketClient::getClient()
 {
 	return mClient;
@@ -213,7 +257,7 @@ void WebSocketClient::onClose( Client* client, websocketpp::connection_hdl handl
 
 void WebSocketClient::onFail( Client* client, websocketpp::connection_hdl handle ) 
 {
-	mHandle = handle;
+	EventScope scope( this, handle );
 	if ( mFailEventHandler != nullptr ) {
 		mFailEventHandler( "Transfer failed." );
 	}
@@ -221,7 +265,7 @@ void WebSocketClient::onFail( Client* client, websocketpp::connection_hdl handle
 
 void WebSocketClient::onHttp( Client* client, websocketpp::connection_hdl handle )
 {
-	mHandle = handle;
+	EventScope scope( this, handle );
 	if ( mHttpEventHandler != nullptr ) {
 		mHttpEventHandler();
 	}
@@ -229,7 +273,7 @@ void WebSocketClient::onHttp( Client* client, websocketpp::connection_hdl handle
 
 void WebSocketClient::onInterrupt( Client* client, websocketpp::connection_hdl handle ) 
 {
-	mHandle = handle;
+	EventScope scope( this, handle );
 	if ( mInterruptEventHandler != nullptr ) {
 		mInterruptEventHandler();
 	}
@@ -237,15 +281,18 @@ void WebSocketClient::onInterrupt( Client* client, websocketpp::connection_hdl h
 
 void WebSocketClient::onMessage( Client* client, websocketpp::connection_hdl handle, MessageRef msg )
 {
-	mHandle = handle;
-	if ( mMessageEventHandler != nullptr ) {
-		mMessageEventHandler( msg->get_payload() );
-	}
+	EventScope scope( this, handle );
+	scope.setMessageTime( std::chrono::steady_clock::now() );
+	// the payload is handed out in place, msg keeps it alive
+	const std::string& payload = msg->get_payload();
+	countIn( msg->get_opcode(), payload.size() );
+	WebSocketMessageView view = { payload.data(), payload.size(), msg->get_opcode(), std::move( msg ) };
+	dispatchMessage( view );
 }
 
 void WebSocketClient::onOpen( Client* client, websocketpp::connection_hdl handle )
 {
-	mHandle = handle;
+	EventScope scope( this, handle );
 	if ( mOpenEventHandler != nullptr ) {
 		mOpenEventHandler();
 	}
@@ -253,7 +300,9 @@ void WebSocketClient::onOpen( Client* client, websocketpp::connection_hdl handle
 
 void WebSocketClient::onPong( Client* client, websocketpp::connection_hdl handle, string msg )
 {
-	mHandle = handle;
+	EventScope scope( this, handle );
+	pongReceived();
+	countIn( websocketpp::frame::opcode::PONG, msg.size() );
 	if ( mPingEventHandler != nullptr ) {
 		mPingEventHandler( msg );
 	}
@@ -261,8 +310,8 @@ void WebSocketClient::onPong( Client* client, websocketpp::connection_hdl handle
 
 void WebSocketClient::onSocketInit( Client* client, websocketpp::connection_hdl handle, asio::ip::tcp::socket& socket )
 {
-	mHandle = handle;
-	mSocket = &socket;
+	EventScope scope( this, handle );
+	setSocket( &socket );
 	if ( mSocketInitEventHandler != nullptr ) {
 		mSocketInitEventHandler();
 	}
@@ -270,7 +319,7 @@ void WebSocketClient::onSocketInit( Client* client, websocketpp::connection_hdl
 
 void WebSocketClient::onTcpPostInit( Client* client, websocketpp::connection_hdl handle )
 {
-	mHandle = handle;
+	EventScope scope( this, handle );
 	if ( mTcpPostInitEventHandler != nullptr ) {
 		mTcpPostInitEventHandler();
 	}
@@ -278,7 +327,7 @@ void WebSocketClient::onTcpPostInit( Client* client, websocketpp::connection_hdl
  
 void WebSocketClient::onTcpPreInit( Client* client, websocketpp::connection_hdl handle )
 {
-	mHandle = handle;
+	EventScope scope( this, handle );
 	if ( mTcpPreInitEventHandler != nullptr ) {
 		mTcpPreInitEventHandler();
 	}
@@ -286,7 +335,7 @@ void WebSocketClient::onTcpPreInit( Client* client, websocketpp::connection_hdl
  
 bool WebSocketClient::onValidate( Client* client, websocketpp::connection_hdl handle )
 {
-	mHandle = handle;
+	EventScope scope( this, handle );
 	if ( mValidateEventHandler != nullptr ) {
 		mValidateEventHandler();
 	}
@@ -48,20 +48,29 @@ public:
 	typedef websocketpp::config::asio_client::message_type::ptr		MessageRef;
 
 	WebSocketClient();
+	//! Runs on an external io_service shared with other clients, poll() and run() are left to its owner.
+	WebSocketClient( asio::io_service* ioService );
 	~WebSocketClient();
 
 	void			connect( const std::string& uri );
 	void			disconnect();
 	void			ping( const std::string& msg = "" );
 	void			poll();
+	void			run();
+	void			stop();
 	void			write( const std::string& msg );
 	// Bruce LANE, check if needed: void			writeBinary(const void *ptr, size_t len);
 	void			write(void const * msg, size_t len);
 
+	WebSocketStats	getStats() const override;
+
 	Client&			getClient();
 	const Client&	getClient() const;
 protected:
 	Client			mClient;
+	bool			mOwnsIoService;
+
+	void			initHandlers();
 	
 	void			onClose( Client* client, websocketpp::connection_hdl handle );
 	void			onFail( Client* client, websocketpp::connection_hdl handle );
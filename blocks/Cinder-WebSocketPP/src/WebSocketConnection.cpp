@@ -72,16 +72,25 @@
 
 #include "websocketpp/common/connection_hdl.hpp"
 
+#include <algorithm>
+
 using namespace std;
 
 WebSocketConnection::WebSocketConnection()
 : mCloseEventHandler( nullptr ), mFailEventHandler( nullptr ), 
 mHttpEventHandler( nullptr ), mInterruptEventHandler( nullptr ), 
-mMessageEventHandler( nullptr ), mOpenEventHandler( nullptr ), 
+mMessageEventHandler( nullptr ), mBinaryMessageEventHandler( nullptr ), mMessageViewEventHandler( nullptr ), mOpenEventHandler( nullptr ), 
 mPingEventHandler( nullptr ), mSocket( nullptr ), mSocketInitEventHandler( nullptr ),
 mTcpPostInitEventHandler( nullptr ), mTcpPreInitEventHandler( nullptr ), 
-mValidateEventHandler( nullptr ), mWriteEventHandler( nullptr )
+mValidateEventHandler( nullptr ), mWriteEventHandler( nullptr ), 
+mPingSentTime( 0 ), mRttSmoothed( 0 ), mRttLast( 0 ), mRttMax( 0 ), mPingsSent( 0 ), mPongsReceived( 0 )
 {
+	for ( size_t i = 0; i < WebSocketStats::kOpcodeCount; ++i ) {
+		mMessagesIn[ i ]	= 0;
+		mBytesIn[ i ]		= 0;
+		mMessagesOut[ i ]	= 0;
+		mBytesOut[ i ]		= 0;
+	}
 }
 
 WebSocketConnection::~WebSocketConnection()
@@ -91,6 +100,8 @@ WebSocketConnection::~WebSocketConnection()
 	disconnectHttpEventHandler();
 	disconnectInterruptEventHandler();
 	disconnectMessageEventHandler();
+	disconnectBinaryMessageEventHandler();
+	disconnectMessageViewEventHandler();
 	disconnectOpenEventHandler();
 	disconnectPingEventHandler();
 	disconnectSocketInitEventHandler();
@@ -100,16 +111,131 @@ WebSocketConnection::~WebSocketConnection()
 	disconnectWriteEventHandler();
 }
 
-const websocketpp::connection_hdl& WebSocketConnection::getHandle() const
+thread_local WebSocketConnection::EventScope* WebSocketConnection::sEventScope = nullptr;
+
+WebSocketConnection::EventScope::EventScope( WebSocketConnection* connection, websocketpp::connection_hdl handle )
+: mConnection( connection ), mPrevious( sEventScope ), mHandle( handle )
 {
+	sEventScope = this;
+	lock_guard<mutex> lock( mConnection->mMutex );
+	mConnection->mHandle = handle;
+}
+
+WebSocketConnection::EventScope::~EventScope()
+{
+	sEventScope = mPrevious;
+}
+
+void WebSocketConnection::EventScope::setMessageTime( std::chrono::steady_clock::time_point time )
+{
+	mMessageTime = time;
+	lock_guard<mutex> lock( mConnection->mMutex );
+	mConnection->mMessageTime = time;
+}
+
+const WebSocketConnection::EventScope* WebSocketConnection::getEventScope() const
+{
+	for ( const EventScope* scope = sEventScope; scope != nullptr; scope = scope->mPrevious ) {
+		if ( scope->mConnection == this ) {
+			return scope;
+		}
+	}
+	return nullptr;
+}
+
+websocketpp::connection_hdl WebSocketConnection::getHandle() const
+{
+	const EventScope* scope = getEventScope();
+	if ( scope != nullptr ) {
+		return scope->mHandle;
+	}
+	lock_guard<mutex> lock( mMutex );
 	return mHandle;
 }
 
 asio::ip::tcp::socket* WebSocketConnection::getSocket() const
 {
+	lock_guard<mutex> lock( mMutex );
 	return mSocket;
 }
 
+void WebSocketConnection::setSocket( asio::ip::tcp::socket* socket )
+{
+	lock_guard<mutex> lock( mMutex );
+	mSocket = socket;
+}
+
+WebSocketStats WebSocketConnection::getStats() const
+{
+	WebSocketStats stats;
+	for ( size_t i = 0; i < WebSocketStats::kOpcodeCount; ++i ) {
+		stats.messagesIn[ i ]	= mMessagesIn[ i ];
+		stats.bytesIn[ i ]		= mBytesIn[ i ];
+		stats.messagesOut[ i ]	= mMessagesOut[ i ];
+		stats.bytesOut[ i ]		= mBytesOut[ i ];
+	}
+	stats.sendQueueDepth	= 0;
+	stats.bufferedAmount	= 0;
+	stats.rttSmoothed		= mRttSmoothed;
+	stats.rttLast			= mRttLast;
+	stats.rttMax			= mRttMax;
+	stats.pingsSent			= mPingsSent;
+	stats.pongsReceived		= mPongsReceived;
+	return stats;
+}
+
+void WebSocketConnection::countIn( websocketpp::frame::opcode::value opcode, size_t bytes )
+{
+	size_t i = opcode % WebSocketStats::kOpcodeCount;
+	++mMessagesIn[ i ];
+	mBytesIn[ i ] += bytes;
+}
+
+void WebSocketConnection::countOut( websocketpp::frame::opcode::value opcode, size_t bytes )
+{
+	size_t i = opcode % WebSocketStats::kOpcodeCount;
+	++mMessagesOut[ i ];
+	mBytesOut[ i ] += bytes;
+}
+
+void WebSocketConnection::pingSent()
+{
+	// a ping still unanswered keeps its time, the round trip only gets longer
+	int64_t expected = 0;
+	int64_t now = chrono::duration_cast<chrono::microseconds>( chrono::steady_clock::now().time_since_epoch() ).count();
+	mPingSentTime.compare_exchange_strong( expected, now );
+	++mPingsSent;
+}
+
+void WebSocketConnection::pongReceived()
+{
+	++mPongsReceived;
+	int64_t sent = mPingSentTime.exchange( 0 );
+	if ( sent == 0 ) {
+		// unsolicited pong
+		return;
+	}
+	int64_t now = chrono::duration_cast<chrono::microseconds>( chrono::steady_clock::now().time_since_epoch() ).count();
+	uint64_t rtt = (uint64_t)max<int64_t>( now - sent, 0 );
+	mRttLast = rtt;
+	// gain of 1/8 like TCP
+	uint64_t smoothed = mRttSmoothed;
+	mRttSmoothed = smoothed == 0 ? rtt : smoothed - smoothed / 8 + rtt / 8;
+	if ( rtt > mRttMax ) {
+		mRttMax = rtt;
+	}
+}
+
+std::chrono::steady_clock::time_point WebSocketConnection::getMessageTime() const
+{
+	const EventScope* scope = getEventScope();
+	if ( scope != nullptr ) {
+		return scope->mMessageTime;
+	}
+	lock_guard<mutex> lock( mMutex );
+	return mMessageTime;
+}
+
 void WebSocketConnection::connectCloseEventHandler( const function<void()>& eventHandler )
 {
 	mCloseEventHandler = eventHandler;
@@ -160,6 +286,37 @@ void WebSocketConnection::disconnectMessageEventHandler()
 	mMessageEventHandler = nullptr;
 }
 
+void WebSocketConnection::connectBinaryMessageEventHandler( const function<void( const void*, size_t )>& eventHandler )
+{
+	mBinaryMessageEventHandler = eventHandler;
+}
+
+void WebSocketConnection::disconnectBinaryMessageEventHandler()
+{
+	mBinaryMessageEventHandler = nullptr;
+}
+
+void WebSocketConnection::connectMessageViewEventHandler( const function<void( const WebSocketMessageView& )>& eventHandler )
+{
+	mMessageViewEventHandler = eventHandler;
+}
+
+void WebSocketConnection::disconnectMessageViewEventHandler()
+{
+	mMessageViewEventHandler = nullptr;
+}
+
+void WebSocketConnection::dispatchMessage( const WebSocketMessageView& msg )
+{
+	if ( mMessageViewEventHandler != nullptr ) {
+		mMessageViewEventHandler( msg );
+	} else if ( msg.opcode == websocketpp::frame::opcode::BINARY && mBinaryMessageEventHandler != nullptr ) {
+		mBinaryMessageEventHandler( msg.data, msg.size );
+	} else if ( mMessageEventHandler != nullptr ) {
+		mMessageEventHandler( std::string( msg.data, msg.size ) );
+	}
+}
+
 void WebSocketConnection::connectOpenEventHandler( const function<void()>& eventHandler )
 {
 	mOpenEventHandler = eventHandler;
@@ -55,6 +55,42 @@
 #include "websocketpp/common/random.hpp"
 #include "websocketpp/common/thread.hpp"
 #include "websocketpp/common/connection_hdl.hpp"
+#include "websocketpp/frame.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+//! A received message in place. The payload stays valid as long as keepAlive is held.
+struct WebSocketMessageView
+{
+	const char*							data;
+	size_t								size;
+	websocketpp::frame::opcode::value	opcode;
+	std::shared_ptr<void>				keepAlive;
+};
+
+//! Traffic and health counters of a connection, see WebSocketConnection::getStats().
+struct WebSocketStats
+{
+	//! Indexed by opcode: 1 text, 2 binary, 9 ping, 10 pong
+	static const size_t	kOpcodeCount = 16;
+
+	uint64_t			messagesIn[ kOpcodeCount ];
+	uint64_t			bytesIn[ kOpcodeCount ];
+	uint64_t			messagesOut[ kOpcodeCount ];
+	uint64_t			bytesOut[ kOpcodeCount ];
+	//! Messages and payload bytes queued but not handed to the socket yet
+	size_t				sendQueueDepth;
+	size_t				bufferedAmount;
+	//! Ping to pong round trip in microseconds, smoothed like TCP's srtt, and the last
+	//! and worst seen. 0 until the first pong.
+	uint64_t			rttSmoothed;
+	uint64_t			rttLast;
+	uint64_t			rttMax;
+	uint64_t			pingsSent;
+	uint64_t			pongsReceived;
+};
 
 class WebSocketConnection
 {
@@ -66,8 +102,13 @@ public:
 	virtual void	poll() = 0;
 	virtual void	write( const std::string& msg ) = 0;
 
-	const websocketpp::connection_hdl&	getHandle() const;
+	//! The connection of the event being handled on this thread, or else of the last event on any thread.
+	websocketpp::connection_hdl			getHandle() const;
 	asio::ip::tcp::socket*				getSocket() const;
+	//! Steady clock time the message being handled on this thread was read, for latency measurements.
+	std::chrono::steady_clock::time_point	getMessageTime() const;
+	//! Snapshot of the counters, safe from any thread.
+	virtual WebSocketStats				getStats() const;
 
 	template<typename T, typename Y>
 	inline void	connectCloseEventHandler( T eventHandler, Y* eventHandlerObject )
@@ -109,6 +150,24 @@ public:
 	void		connectMessageEventHandler( const std::function<void( std::string )>& eventHandler );
 	void		disconnectMessageEventHandler();
 
+	template<typename T, typename Y>
+	inline void	connectBinaryMessageEventHandler( T eventHandler, Y* eventHandlerObject )
+	{
+		connectBinaryMessageEventHandler( std::bind( eventHandler, eventHandlerObject, std::placeholders::_1, std::placeholders::_2 ) );
+	}
+	//! Receives BINARY messages in place. Without it they go to the message handler as a string.
+	void		connectBinaryMessageEventHandler( const std::function<void( const void*, size_t )>& eventHandler );
+	void		disconnectBinaryMessageEventHandler();
+
+	template<typename T, typename Y>
+	inline void	connectMessageViewEventHandler( T eventHandler, Y* eventHandlerObject )
+	{
+		connectMessageViewEventHandler( std::bind( eventHandler, eventHandlerObject, std::placeholders::_1 ) );
+	}
+	//! Receives every message without copying its payload. Takes precedence over the message and binary message handlers.
+	void		connectMessageViewEventHandler( const std::function<void( const WebSocketMessageView& )>& eventHandler );
+	void		disconnectMessageViewEventHandler();
+
 	template<typename T, typename Y>
 	inline void	connectOpenEventHandler( T eventHandler, Y* eventHandlerObject )
 	{
@@ -165,14 +224,61 @@ public:
 	void		connectWriteEventHandler( const std::function<void()>& eventHandler );
 	void		disconnectWriteEventHandler();
 protected:
+	//! Set for the duration of a handler. Handlers can run on several threads at
+	//! once, each sees its own connection through getHandle() and getMessageTime().
+	class EventScope
+	{
+	public:
+		EventScope( WebSocketConnection* connection, websocketpp::connection_hdl handle );
+		~EventScope();
+
+		void							setMessageTime( std::chrono::steady_clock::time_point time );
+	private:
+		WebSocketConnection*			mConnection;
+		EventScope*						mPrevious;
+		websocketpp::connection_hdl		mHandle;
+		std::chrono::steady_clock::time_point	mMessageTime;
+
+		friend class WebSocketConnection;
+	};
+
+	//! Innermost scope on this thread
+	static thread_local EventScope*		sEventScope;
+
+	//! Guards mHandle, mSocket and mMessageTime
+	mutable std::mutex					mMutex;
 	websocketpp::connection_hdl			mHandle;
 	asio::ip::tcp::socket*				mSocket;
+	std::chrono::steady_clock::time_point	mMessageTime;
+
+	void								setSocket( asio::ip::tcp::socket* socket );
+
+	std::atomic<uint64_t>				mMessagesIn[ WebSocketStats::kOpcodeCount ];
+	std::atomic<uint64_t>				mBytesIn[ WebSocketStats::kOpcodeCount ];
+	std::atomic<uint64_t>				mMessagesOut[ WebSocketStats::kOpcodeCount ];
+	std::atomic<uint64_t>				mBytesOut[ WebSocketStats::kOpcodeCount ];
+	//! Steady clock microseconds of the ping waiting for its pong, 0 if none
+	std::atomic<int64_t>				mPingSentTime;
+	std::atomic<uint64_t>				mRttSmoothed;
+	std::atomic<uint64_t>				mRttLast;
+	std::atomic<uint64_t>				mRttMax;
+	std::atomic<uint64_t>				mPingsSent;
+	std::atomic<uint64_t>				mPongsReceived;
+
+	void								countIn( websocketpp::frame::opcode::value opcode, size_t bytes );
+	void								countOut( websocketpp::frame::opcode::value opcode, size_t bytes );
+	void								pingSent();
+	void								pongReceived();
+	//! The innermost scope on this thread, if it belongs to this connection
+	const EventScope*					getEventScope() const;
 	
 	std::function<void()>				mCloseEventHandler;
 	std::function<void( std::string )>	mFailEventHandler;
 	std::function<void()>				mHttpEventHandler;
 	std::function<void()>				mInterruptEventHandler;
 	std::function<void( std::string )>	mMessageEventHandler;
+	std::function<void( const void*, size_t )>	mBinaryMessageEventHandler;
+	std::function<void( const WebSocketMessageView& )>	mMessageViewEventHandler;
 	std::function<void()>				mOpenEventHandler;
 	std::function<void( std::string )>	mPingEventHandler;
 	std::function<void()>				mSocketInitEventHandler;
@@ -180,4 +286,7 @@ protected:
 	std::function<void()>				mTcpPostInitEventHandler;
 	std::function<bool()>				mValidateEventHandler;
 	std::function<void()>				mWriteEventHandler;
+
+	//! Hands a received message to the view handler, or copies it for the binary and string handlers.
+	void								dispatchMessage( const WebSocketMessageView& msg );
 };
@@ -42,12 +42,27 @@ using namespace ci;
 using namespace std;
 
 WebSocketServer::WebSocketServer()
+: mOwnsIoService( true ), mMaxBufferedAmount( 4 * 1024 * 1024 ), mNumDroppedMessages( 0 ), mHttpRequestEventHandler( nullptr )
 {
 	mServer.set_access_channels( websocketpp::log::alevel::all );
 	mServer.clear_access_channels( websocketpp::log::alevel::frame_payload );
 	
 	mServer.init_asio();
-	
+	initHandlers();
+}
+
+WebSocketServer::WebSocketServer( asio::io_service* ioService )
+: mOwnsIoService( false ), mMaxBufferedAmount( 4 * 1024 * 1024 ), mNumDroppedMessages( 0 ), mHttpRequestEventHandler( nullptr )
+{
+	mServer.clear_access_channels( websocketpp::log::alevel::all );
+	mServer.clear_error_channels( websocketpp::log::elevel::all );
+
+	mServer.init_asio( ioService );
+	initHandlers();
+}
+
+void WebSocketServer::initHandlers()
+{
 	mServer.set_close_handler(			bind( &WebSocketServer::onClose,		this, &mServer, std::placeholders::_1 ) );
 	mServer.set_fail_handler(			bind( &WebSocketServer::onFail,			this, &mServer, std::placeholders::_1 ) );
 	mServer.set_http_handler(			bind( &WebSocketServer::onHttp,			this, &mServer, std::placeholders::_1 ) );
@@ -55,6 +70,7 @@ WebSocketServer::WebSocketServer()
 	mServer.set_message_handler(		bind( &WebSocketServer::onMessage,		this, &mServer, std::placeholders::_1, std::placeholders::_2 ) );
 	mServer.set_open_handler(			bind( &WebSocketServer::onOpen,			this, &mServer, std::placeholders::_1 ) );
 	mServer.set_ping_handler(			bind( &WebSocketServer::onPing,			this, &mServer, std::placeholders::_1, std::placeholders::_2 ) );
+	mServer.set_pong_handler(			bind( &WebSocketServer::onPong,			this, &mServer, std::placeholders::_1, std::placeholders::_2 ) );
 	mServer.set_socket_init_handler(	bind( &WebSocketServer::onSocketInit,	this, &mServer, std::placeholders::_1, std::placeholders::_2 ) );
 	mServer.set_tcp_post_init_handler(	bind( &WebSocketServer::onTcpPostInit,	this, &mServer, std::placeholders::_1 ) );
 	mServer.set_tcp_pre_init_handler(	bind( &WebSocketServer::onTcpPreInit,	this, &mServer, std::placeholders::_1 ) );
@@ -63,7 +79,17 @@ WebSocketServer::WebSocketServer()
 
 WebSocketServer::~WebSocketServer()
 {
-	if ( !mServer.stopped() ) {
+	disconnectHttpRequestEventHandler();
+	if ( !mOwnsIoService ) {
+		// the shared io_service keeps running for its other users
+		if ( mServer.is_listening() ) {
+			cancel();
+		}
+		for ( const websocketpp::connection_hdl& handle : getConnections() ) {
+			websocketpp::lib::error_code err;
+			mServer.close( handle, websocketpp::close::status::going_away, "", err );
+		}
+	} else if ( !mServer.stopped() ) {
 		cancel();
 		mServer.stop();
 	}
@@ -91,6 +117,8 @@ void WebSocketServer::cancel()
 void WebSocketServer::listen( uint16_t port )
 {
 	try {
+		// the endpoint defaults to a backlog of 0, a burst of clients connecting at once stalls in their handshake
+		mServer.set_listen_backlog( asio::socket_base::max_connections );
 		mServer.listen( port );
 		mServer.start_accept();
 	} catch ( const std::exception& ex ) {
@@ -111,7 +139,9 @@ void WebSocketServer::listen( uint16_t port )
 void WebSocketServer::ping( const string& msg )
 {
 	try {
-		mServer.get_con_from_hdl( mHandle )->pong( msg );
+		mServer.get_con_from_hdl( getHandle() )->ping( msg );
+		pingSent();
+		countOut( websocketpp::frame::opcode::PING, msg.size() );
 	} catch( ... ) {
 		if ( mFailEventHandler != nullptr ) {
 			mFailEventHandler( "Ping failed." );
@@ -129,6 +159,28 @@ void WebSocketServer::run()
 	mServer.run();
 }
 
+void WebSocketServer::run( size_t numThreads )
+{
+	// the calling thread is one of them
+	vector<thread> threads;
+	for ( size_t i = 1; i < numThreads; ++i ) {
+		threads.emplace_back( [ this ]()
+		{
+			try {
+				mServer.run();
+			} catch ( const std::exception& ex ) {
+				if ( mFailEventHandler != nullptr ) {
+					mFailEventHandler( ex.what() );
+				}
+			}
+		} );
+	}
+	mServer.run();
+	for ( thread& t : threads ) {
+		t.join();
+	}
+}
+
 void WebSocketServer::write( void const * msg, size_t len )
 {
 	if (len == 0){
@@ -137,7 +189,12 @@ void WebSocketServer::write( void const * msg, size_t len )
 		}
 	} else {
 		websocketpp::lib::error_code err;
-		mServer.send(mHandle,
+		websocketpp::connection_hdl handle = getHandle();
+		ConnectionRef con = mServer.get_con_from_hdl( handle, err );
+		if ( !err && !canSend( con ) ) {
+			return;
+		}
+		mServer.send(handle,
 					 msg,
 					 len,
 					 websocketpp::frame::opcode::BINARY,
@@ -147,6 +204,7 @@ void WebSocketServer::write( void const * msg, size_t len )
 				mFailEventHandler(err.message());
 			}
 		} else {
+			countOut( websocketpp::frame::opcode::BINARY, len );
 			if (mWriteEventHandler != nullptr) {
 				mWriteEventHandler();
 			}
@@ -162,12 +220,18 @@ void WebSocketServer::write( const std::string& msg )
 		}
 	} else {
 		websocketpp::lib::error_code err;
-		mServer.send( mHandle, msg, websocketpp::frame::opcode::TEXT, err );
+		websocketpp::connection_hdl handle = getHandle();
+		ConnectionRef con = mServer.get_con_from_hdl( handle, err );
+		if ( !err && !canSend( con ) ) {
+			return;
+		}
+		mServer.send( handle, msg, websocketpp::frame::opcode::TEXT, err );
 		if ( err ) {
 			if ( mFailEventHandler != nullptr ) {
 				mFailEventHandler( err.message() );
 			}
 		} else {
+			countOut( websocketpp::frame::opcode::TEXT, msg.size() );
 			if ( mWriteEventHandler != nullptr ) {
 				mWriteEventHandler();
 			}
@@ -175,6 +239,117 @@ void WebSocketServer::write( const std::string& msg )
 	}
 }
 
+void WebSocketServer::broadcast( const std::string& msg )
+{
+	broadcast( msg.data(), msg.size(), websocketpp::frame::opcode::TEXT );
+}
+
+void WebSocketServer::broadcast( void const * msg, size_t len )
+{
+	broadcast( msg, len, websocketpp::frame::opcode::BINARY );
+}
+
+void WebSocketServer::broadcast( void const * msg, size_t len, websocketpp::frame::opcode::value opcode )
+{
+	if ( len == 0 ) {
+		if ( mFailEventHandler != nullptr ) {
+			mFailEventHandler( "Cannot send empty message." );
+		}
+		return;
+	}
+	vector<websocketpp::connection_hdl> handles = getConnections();
+	if ( handles.empty() ) {
+		return;
+	}
+
+	// Server frames are never masked and this config has no compression, so
+	// the header and payload are the same for every connection.
+	MessageRef frame = make_shared<Message>( nullptr, opcode, len );
+	frame->set_payload( msg, len );
+	websocketpp::frame::basic_header header( opcode, len, true, false );
+	websocketpp::frame::extended_header extended( len );
+	frame->set_header( websocketpp::frame::prepare_header( header, extended ) );
+	frame->set_prepared( true );
+
+	bool sent = false;
+	for ( const websocketpp::connection_hdl& handle : handles ) {
+		websocketpp::lib::error_code err;
+		ConnectionRef con = mServer.get_con_from_hdl( handle, err );
+		if ( err || !canSend( con ) ) {
+			continue;
+		}
+		// Hixie-76 clients have their own framing
+		if ( con->get_request_header( "Sec-WebSocket-Version" ).empty() ) {
+			err = con->send( msg, len, opcode );
+		} else {
+			err = con->send( frame );
+		}
+		if ( err ) {
+			if ( mFailEventHandler != nullptr ) {
+				mFailEventHandler( err.message() );
+			}
+		} else {
+			countOut( opcode, len );
+			sent = true;
+		}
+	}
+	if ( sent && mWriteEventHandler != nullptr ) {
+		mWriteEventHandler();
+	}
+}
+
+bool WebSocketServer::canSend( const ConnectionRef& con )
+{
+	size_t limit = mMaxBufferedAmount;
+	if ( limit > 0 && con->get_buffered_amount() >= limit ) {
+		++mNumDroppedMessages;
+		return false;
+	}
+	return true;
+}
+
+void WebSocketServer::setMaxBufferedAmount( size_t bytes )
+{
+	mMaxBufferedAmount = bytes;
+}
+
+size_t WebSocketServer::getMaxBufferedAmount() const
+{
+	return mMaxBufferedAmount;
+}
+
+uint64_t WebSocketServer::getNumDroppedMessages() const
+{
+	return mNumDroppedMessages;
+}
+
+size_t WebSocketServer::getNumConnections() const
+{
+	lock_guard<mutex> lock( mConnectionsMutex );
+	return mConnections.size();
+}
+
+vector<websocketpp::connection_hdl> WebSocketServer::getConnections() const
+{
+	lock_guard<mutex> lock( mConnectionsMutex );
+	return vector<websocketpp::connection_hdl>( mConnections.begin(), mConnections.end() );
+}
+
+WebSocketStats WebSocketServer::getStats() const
+{
+	// queues of all connections together
+	WebSocketStats stats = WebSocketConnection::getStats();
+	for ( const websocketpp::connection_hdl& handle : getConnections() ) {
+		websocketpp::lib::error_code err;
+		ConnectionRef con = const_cast<Server&>( mServer ).get_con_from_hdl( handle, err );
+		if ( !err ) {
+			stats.sendQueueDepth	+= con->get_send_queue_size();
+			stats.bufferedAmount	+= con->get_buffered_amount();
+		}
+	}
+	return stats;
+}
+
 WebSocketServer::Server& WebSocketServer::getServer()
 {
 	return mServer;
@@ -187,6 +362,10 @@ const WebSocketServer::Server& WebSocketServer::getServer() const
 
 void WebSocketServer::onClose( Server* server, websocketpp::connection_hdl handle )
 {
+	{
+		lock_guard<mutex> lock( mConnectionsMutex );
+		mConnections.erase( handle );
+	}
 	if ( mCloseEventHandler != nullptr ) {
 		mCloseEventHandler();
 	}
@@ -194,7 +373,11 @@ void WebSocketServer::onClose( Server* server, websocketpp::connection_hdl handl
 
 void WebSocketServer::onFail( Server* server, websocketpp::connection_hdl handle )
 {
-	mHandle = handle;
+	EventScope scope( this, handle );
+	{
+		lock_guard<mutex> lock( mConnectionsMutex );
+		mConnections.erase( handle );
+	}
 	if ( mFailEventHandler != nullptr ) {
 		mFailEventHandler( "Transfer failed." );
 	}
@@ -202,15 +385,43 @@ void WebSocketServer::onFail( Server* server, websocketpp::connection_hdl handle
 
 void WebSocketServer::onHttp( Server* server, websocketpp::connection_hdl handle )
 {
-	mHandle = handle;
+	EventScope scope( this, handle );
 	if ( mHttpEventHandler != nullptr ) {
 		mHttpEventHandler();
 	}
+	if ( mHttpRequestEventHandler == nullptr ) {
+		return;
+	}
+	websocketpp::lib::error_code err;
+	ConnectionRef con = server->get_con_from_hdl( handle, err );
+	if ( err ) {
+		return;
+	}
+	WebSocketHttpResponse response;
+	response.status			= websocketpp::http::status_code::ok;
+	response.contentType	= "text/plain";
+	if ( con->get_request().get_method() == "GET" && mHttpRequestEventHandler( con->get_resource(), response ) ) {
+		con->set_status( response.status );
+		con->replace_header( "Content-Type", response.contentType );
+		con->set_body( response.body );
+	} else {
+		con->set_status( websocketpp::http::status_code::not_found );
+	}
+}
+
+void WebSocketServer::connectHttpRequestEventHandler( const function<bool( const string&, WebSocketHttpResponse& )>& eventHandler )
+{
+	mHttpRequestEventHandler = eventHandler;
+}
+
+void WebSocketServer::disconnectHttpRequestEventHandler()
+{
+	mHttpRequestEventHandler = nullptr;
 }
 
 void WebSocketServer::onInterrupt( Server* server, websocketpp::connection_hdl handle )
 {
-	mHandle = handle;
+	EventScope scope( this, handle );
 	if ( mInterruptEventHandler != nullptr ) {
 		mInterruptEventHandler();
 	}
@@ -218,15 +429,22 @@ void WebSocketServer::onInterrupt( Server* server, websocketpp::connection_hdl h
 
 void WebSocketServer::onMessage( Server* server, websocketpp::connection_hdl handle, MessageRef msg )
 {
-	mHandle = handle;
-	if ( mMessageEventHandler != nullptr ) {
-		mMessageEventHandler( msg->get_payload() );
-	}
+	EventScope scope( this, handle );
+	scope.setMessageTime( std::chrono::steady_clock::now() );
+	// the payload is handed out in place, msg keeps it alive
+	const std::string& payload = msg->get_payload();
+	countIn( msg->get_opcode(), payload.size() );
+	WebSocketMessageView view = { payload.data(), payload.size(), msg->get_opcode(), std::move( msg ) };
+	dispatchMessage( view );
 }
 
 void WebSocketServer::onOpen( Server* server, websocketpp::connection_hdl handle )
 {
-	mHandle = handle;
+	EventScope scope( this, handle );
+	{
+		lock_guard<mutex> lock( mConnectionsMutex );
+		mConnections.insert( handle );
+	}
 	if ( mOpenEventHandler != nullptr ) {
 		mOpenEventHandler();
 	}
@@ -234,17 +452,30 @@ void WebSocketServer::onOpen( Server* server, websocketpp::connection_hdl handle
 
 bool WebSocketServer::onPing( Server* server, websocketpp::connection_hdl handle, string msg )
 {
-	mHandle = handle;
+	EventScope scope( this, handle );
+	countIn( websocketpp::frame::opcode::PING, msg.size() );
+	// answered by websocketpp since the handler returns true
+	countOut( websocketpp::frame::opcode::PONG, msg.size() );
 	if ( mPingEventHandler != nullptr ) {
 		mPingEventHandler( msg );
 	}
 	return true;
 }
 
+void WebSocketServer::onPong( Server* server, websocketpp::connection_hdl handle, string msg )
+{
+	EventScope scope( this, handle );
+	pongReceived();
+	countIn( websocketpp::frame::opcode::PONG, msg.size() );
+	if ( mPingEventHandler != nullptr ) {
+		mPingEventHandler( msg );
+	}
+}
+
 void WebSocketServer::onSocketInit( Server* server, websocketpp::connection_hdl handle, asio::ip::tcp::socket& socket )
 {
-	mHandle = handle;
-	mSocket = &socket;
+	EventScope scope( this, handle );
+	setSocket( &socket );
 	if ( mSocketInitEventHandler != nullptr ) {
 		mSocketInitEventHandler();
 	}
@@ -252,7 +483,7 @@ void WebSocketServer::onSocketInit( Server* server, websocketpp::connection_hdl
 
 void WebSocketServer::onTcpPostInit( Server* server, websocketpp::connection_hdl handle )
 {
-	mHandle = handle;
+	EventScope scope( this, handle );
 	if ( mTcpPostInitEventHandler != nullptr ) {
 		mTcpPostInitEventHandler();
 	}
@@ -260,7 +491,7 @@ void WebSocketServer::onTcpPostInit( Server* server, websocketpp::connection_hdl
 
 void WebSocketServer::onTcpPreInit( Server* server, websocketpp::connection_hdl handle )
 {
-	mHandle = handle;
+	EventScope scope( this, handle );
 	if ( mTcpPreInitEventHandler != nullptr ) {
 		mTcpPreInitEventHandler();
 	}
@@ -268,7 +499,7 @@ void WebSocketServer::onTcpPreInit( Server* server, websocketpp::connection_hdl
 
 bool WebSocketServer::onValidate( Server* server, websocketpp::connection_hdl handle )
 {
-	mHandle = handle;
+	EventScope scope( this, handle );
 	if ( mValidateEventHandler != nullptr ) {
 		mValidateEventHandler();
 	}
@@ -40,28 +40,87 @@
 #include "websocketpp/config/asio_no_tls.hpp"
 #include "websocketpp/server.hpp"
 
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+//! Answer to a plain HTTP request, see WebSocketServer::connectHttpRequestEventHandler().
+struct WebSocketHttpResponse
+{
+	websocketpp::http::status_code::value	status;
+	std::string								contentType;
+	std::string								body;
+};
+
 class WebSocketServer : public WebSocketConnection
 {
 public:
 	typedef websocketpp::server<websocketpp::config::asio>	Server;
 	typedef Server::connection_ptr							ConnectionRef;
 	typedef Server::message_ptr								MessageRef;
+	typedef Server::connection_type::message_type			Message;
 
 	WebSocketServer();
+	//! Runs on an external io_service, poll() and run() are left to its owner.
+	WebSocketServer( asio::io_service* ioService );
 	~WebSocketServer();
 	
 	void			cancel();
 	void			listen( uint16_t port = 80 );
+	//! Pings the connection of the current handler, or the last one to have an event. Its pong updates the round trip in getStats().
 	void			ping( const std::string& msg = "" );
 	void			poll();
 	void			run();
+	//! Runs the server on \a numThreads threads including the calling one, and returns
+	//! once it stops. Handlers of one connection stay in order on its strand, handlers
+	//! of different connections run concurrently, so event handlers must be thread safe.
+	void			run( size_t numThreads );
 	void			write( const std::string& msg );
 	void			write( void const * msg, size_t len );
 
+	//! Sends \a msg to every open connection. The frame is built once and shared by all of them.
+	void			broadcast( const std::string& msg );
+	void			broadcast( void const * msg, size_t len );
+	//! A connection with this many bytes still waiting to be sent skips writes and broadcasts until it catches up. 0 means no limit.
+	void			setMaxBufferedAmount( size_t bytes );
+	size_t			getMaxBufferedAmount() const;
+	//! Messages skipped because their connection was over the limit.
+	uint64_t		getNumDroppedMessages() const;
+	size_t			getNumConnections() const;
+	std::vector<websocketpp::connection_hdl>	getConnections() const;
+	//! Counters of all connections, queue depth and buffered amount summed over the open ones.
+	WebSocketStats	getStats() const override;
+
+	template<typename T, typename Y>
+	inline void		connectHttpRequestEventHandler( T eventHandler, Y* eventHandlerObject )
+	{
+		connectHttpRequestEventHandler( std::bind( eventHandler, eventHandlerObject, std::placeholders::_1, std::placeholders::_2 ) );
+	}
+	//! Answers plain HTTP GETs on the listening port. Receives the resource ("/metrics?a=b")
+	//! and a 200 text/plain response to fill in, returning false answers 404.
+	void			connectHttpRequestEventHandler( const std::function<bool( const std::string&, WebSocketHttpResponse& )>& eventHandler );
+	void			disconnectHttpRequestEventHandler();
+
 	Server&			getServer();
 	const Server&	getServer() const;
 protected:
-	Server			mServer;
+	typedef std::set<websocketpp::connection_hdl, std::owner_less<websocketpp::connection_hdl>>	ConnectionSet;
+
+	Server					mServer;
+	bool					mOwnsIoService;
+	ConnectionSet			mConnections;
+	mutable std::mutex		mConnectionsMutex;
+	std::atomic<size_t>		mMaxBufferedAmount;
+	std::atomic<uint64_t>	mNumDroppedMessages;
+	std::function<bool( const std::string&, WebSocketHttpResponse& )>	mHttpRequestEventHandler;
+
+	void			initHandlers();
+
+	void			broadcast( void const * msg, size_t len, websocketpp::frame::opcode::value opcode );
+	//! False if \a con is over the buffered amount limit.
+	bool			canSend( const ConnectionRef& con );
 	
 	void			onClose( Server* server, websocketpp::connection_hdl handle );
 	void			onFail( Server* server, websocketpp::connection_hdl handle );
@@ -70,6 +129,7 @@ protected:
 	void			onMessage( Server* server, websocketpp::connection_hdl handle, MessageRef msg );
 	void			onOpen( Server* server, websocketpp::connection_hdl handle );
 	bool			onPing( Server* server, websocketpp::connection_hdl handle, std::string msg );
+	void			onPong( Server* server, websocketpp::connection_hdl handle, std::string msg );
 	void			onSocketInit( Server* server, websocketpp::connection_hdl handle, asio::ip::tcp::socket& socket );
 	void			onTcpPostInit( Server* server, websocketpp::connection_hdl handle );
 	void			onTcpPreInit( Server* server, websocketpp::connection_hdl handle );
@@ -636,6 +636,17 @@ public:
         return get_buffered_amount();
     }
 
+    /// Get the number of messages in the outgoing write queue
+    /**
+     * Messages queued by send, ping, pong or close that have not been handed
+     * to the transport layer yet.
+     *
+     * This method invokes the m_write_lock mutex
+     *
+     * @return The current number of messages in the outgoing send queue.
+     */
+    size_t get_send_queue_size() const;
+
     ////////////////////
     // Action Methods //
     ////////////////////
@@ -1536,7 +1547,7 @@ private:
      * Serializes access to the write queue as well as shared state within the
      * processor.
      */
-    mutex_type              m_write_lock;
+    mutable mutex_type      m_write_lock;
 
     // connection resources
     char                    m_buf[config::connection_read_buffer_size];
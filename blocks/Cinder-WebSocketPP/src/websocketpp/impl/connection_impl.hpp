@@ -69,10 +69,17 @@ std::string const & connection<config>::get_origin() const {
 
 template <typename config>
 size_t connection<config>::get_buffered_amount() const {
-    //scoped_lock_type lock(m_connection_state_lock);
+    // updated by write_push and write_pop under m_write_lock
+    scoped_lock_type lock(m_write_lock);
     return m_send_buffer_size;
 }
 
+template <typename config>
+size_t connection<config>::get_send_queue_size() const {
+    scoped_lock_type lock(m_write_lock);
+    return m_send_queue.size();
+}
+
 template <typename config>
 session::state::value connection<config>::get_state() const {
     //scoped_lock_type lock(m_connection_state_lock);
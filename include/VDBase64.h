@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace videodromm
+{
+	// base64 decoder for inbound image payloads.
+	// picks an AVX2, SSE4.1 or scalar implementation at runtime and decodes
+	// straight into a caller-provided buffer.
+	class VDBase64 {
+	public:
+		// buffer size needed to decode aSize base64 characters
+		static size_t				decodedCapacity(size_t aSize) { return (aSize + 3) / 4 * 3; }
+		// decodes aSrc into aDst (at least decodedCapacity(aSrcSize) bytes).
+		// returns false on invalid input, aDstSize receives the decoded length
+		static bool					decode(const char *aSrc, size_t aSrcSize, uint8_t *aDst, size_t &aDstSize);
+		// "avx2", "sse4.1" or "scalar"
+		static const char *			getImplementationName();
+	};
+}
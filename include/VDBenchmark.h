@@ -0,0 +1,28 @@
+#pragma once
+#include "cinder/Cinder.h"
+
+#include "VDWebsocket.h"
+
+#include <string>
+
+namespace videodromm
+{
+	// timings of the inbound message paths, the parser ones from a capture recorded with
+	// VDWebsocket::startRecording(), and of WebSocketServer under a local client swarm.
+	// run with CinderHydra --bench [capture], each function returns its report as text,
+	// one line per measurement
+	class VDBenchmark {
+	public:
+		// the capture through VDWebsocket's parser (see VDWebsocket::timeReplay()), then its
+		// json messages through JsonTree as parseMessage handled them before VDJsonReader,
+		// and the classification of its text messages by prefix table and by substr
+		static std::string			parse(VDWebsocket &aWebsocket, const ci::fs::path &aPath, int aPasses = 10);
+		// VDBase64 (whichever implementation the cpu gets) against websocketpp::base64_decode
+		// on random 1, 2, 4 and 8 MB payloads
+		static std::string			base64(int aPasses = 10);
+		// a WebSocketServer echoing on aThreads threads to aClients clients on localhost, each
+		// sending aMessages messages tagged with its index: echo throughput and replies that
+		// reached the wrong client or none
+		static std::string			serverLoad(size_t aThreads, size_t aClients = 50, size_t aMessages = 1000);
+	};
+}
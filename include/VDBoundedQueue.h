@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace videodromm
+{
+	// bounded lock-free queue (Dmitry Vyukov's array-based MPMC design).
+	// used as the inbox between network producers and the render thread:
+	// push never blocks, it fails when the queue is full.
+	template<typename T>
+	class VDBoundedQueue {
+	public:
+		// aCapacity is rounded up to a power of two
+		explicit VDBoundedQueue(size_t aCapacity)
+			: mEnqueuePos(0), mDequeuePos(0)
+		{
+			size_t capacity = 2;
+			while (capacity < aCapacity) capacity <<= 1;
+			mMask = capacity - 1;
+			mCells.reset(new Cell[capacity]);
+			for (size_t i = 0; i < capacity; i++) mCells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+
+		bool						push(T &&aValue)
+		{
+			Cell *cell;
+			size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+			for (;;) {
+				cell = &mCells[pos & mMask];
+				size_t sequence = cell->sequence.load(std::memory_order_acquire);
+				intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+				if (diff == 0) {
+					if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+				}
+				else if (diff < 0) {
+					// full
+					return false;
+				}
+				else {
+					pos = mEnqueuePos.load(std::memory_order_relaxed);
+				}
+			}
+			cell->data = std::move(aValue);
+			cell->sequence.store(pos + 1, std::memory_order_release);
+			return true;
+		}
+
+		bool						pop(T &aValue)
+		{
+			Cell *cell;
+			size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+			for (;;) {
+				cell = &mCells[pos & mMask];
+				size_t sequence = cell->sequence.load(std::memory_order_acquire);
+				intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+				if (diff == 0) {
+					if (mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+				}
+				else if (diff < 0) {
+					// empty
+					return false;
+				}
+				else {
+					pos = mDequeuePos.load(std::memory_order_relaxed);
+				}
+			}
+			aValue = std::move(cell->data);
+			cell->sequence.store(pos + mMask + 1, std::memory_order_release);
+			return true;
+		}
+	private:
+		struct Cell {
+			std::atomic<size_t>		sequence;
+			T						data;
+		};
+		std::unique_ptr<Cell[]>		mCells;
+		size_t						mMask;
+		// keep producers and consumer on separate cache lines
+		char						mPad0[64];
+		std::atomic<size_t>			mEnqueuePos;
+		char						mPad1[64];
+		std::atomic<size_t>			mDequeuePos;
+	};
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include "cinder/Cinder.h"
+#include "cinder/Surface.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace videodromm
+{
+	// a decoded canvas frame, ready to upload
+	struct VDCanvasFrame {
+		ci::Surface8uRef			surface;
+		uint64_t					sequence;
+		// from the binary header, 0 for json frames
+		uint32_t					senderSequence;
+		uint64_t					senderTimestamp;
+		// steady clock microseconds: read from the socket, decoding finished
+		uint64_t					received;
+		uint64_t					decoded;
+	};
+
+	// canvas ingest counters, see VDWebsocket::getCanvasStats()
+	struct VDCanvasStats {
+		uint64_t					received;
+		uint64_t					dropped;	// superseded before being presented
+		uint64_t					failed;		// could not be decoded
+		uint64_t					presented;
+		// json (base64 text) vs binary protocol: frames, payload bytes and decode time
+		uint64_t					jsonFrames;
+		uint64_t					jsonBytes;
+		double						jsonDecodeSeconds;
+		uint64_t					binaryFrames;
+		uint64_t					binaryBytes;
+		double						binaryDecodeSeconds;
+	};
+
+	// header of a binary canvas frame, followed by the jpeg or rgba bytes.
+	// little-endian, 28 bytes: "HYDC", version, format, 2 reserved bytes,
+	// width, height, sequence (uint32), timestamp in ms (uint64)
+	struct VDCanvasHeader {
+		enum Format { JPEG = 0, RGBA = 1 };
+		static const size_t			kSize = 28;
+		static const uint8_t		kVersion = 1;
+		// larger frames are refused, rgba width * height * 4 then fits in 32 bits
+		static const uint32_t		kMaxDimension = 16384;
+		uint8_t						version;
+		uint8_t						format;
+		uint32_t					width;
+		uint32_t					height;
+		uint32_t					sequence;
+		uint64_t					timestamp;
+		// false if the payload doesn't start with a valid header
+		static bool					parse(const uint8_t *aData, size_t aSize, VDCanvasHeader &aHeader);
+	};
+
+	// decodes hydra canvas frames (base64 jpeg, raw jpeg or raw rgba) on worker threads.
+	// ingest is latest-wins: a frame still waiting for a worker is replaced by the
+	// next one before any decoding happens. the latest finished frame is published
+	// through a single atomic slot, the render thread only picks up finished frames.
+	typedef std::shared_ptr<class VDCanvasDecoder> VDCanvasDecoderRef;
+	class VDCanvasDecoder {
+	public:
+		VDCanvasDecoder(unsigned int aNumWorkers);
+		~VDCanvasDecoder();
+		static VDCanvasDecoderRef	create(unsigned int aNumWorkers = 2)
+		{
+			return std::shared_ptr<VDCanvasDecoder>(new VDCanvasDecoder(aNumWorkers));
+		}
+		// put the payload in the pending slot, replacing a frame not yet picked up.
+		// aReceived is carried through to the acquired frame for latency measurements.
+		// with aOwner the payload is decoded in place and aOwner is held until then, without it is copied
+		void						submitBase64(const char *aData, size_t aSize, uint64_t aReceived = 0, const std::shared_ptr<void> &aOwner = nullptr);
+		// binary protocol, aData points past the header
+		void						submitBinary(const VDCanvasHeader &aHeader, const uint8_t *aData, size_t aSize, uint64_t aReceived = 0, const std::shared_ptr<void> &aOwner = nullptr);
+		// render thread: true when a newer frame than the last acquired one is ready
+		bool						acquireFrame(ci::Surface8uRef &aSurface);
+		bool						acquireFrame(VDCanvasFrame &aFrame);
+		bool						hasFrame() const { return mReady.load(std::memory_order_acquire) != nullptr; }
+		VDCanvasStats				getStats() const;
+	private:
+		enum Format { FORMAT_BASE64, FORMAT_JPEG, FORMAT_RGBA };
+		struct Job {
+			// payload and size point into the owner's buffer, data is a copy when there is no owner
+			const char *			payload;
+			size_t					size;
+			std::shared_ptr<void>	owner;
+			std::string				data;
+			Format					format;
+			uint32_t				width;
+			uint32_t				height;
+			uint32_t				senderSequence;
+			uint64_t				senderTimestamp;
+			uint64_t				received;
+			uint64_t				sequence;
+		};
+
+		void						submit(const char *aData, size_t aSize, Format aFormat, const VDCanvasHeader *aHeader, uint64_t aReceived, const std::shared_ptr<void> &aOwner);
+		void						workerLoop();
+		void						decode(const Job &aJob, std::vector<uint8_t> &aScratch);
+		ci::Surface8uRef			decodeJpeg(const void *aData, size_t aSize);
+		void						publish(VDCanvasFrame *aFrame);
+
+		std::vector<std::thread>	mWorkers;
+		std::mutex					mJobMutex;
+		std::condition_variable		mJobCondition;
+		bool						mRunning;
+		// latest-wins pending slot, buffers are swapped around so their capacity is reused.
+		// a pending sequence of 0 means the slot is empty
+		Job							mPending;
+		Job							mSpare;
+		uint64_t					mNextSequence;
+
+		std::atomic<VDCanvasFrame *>	mReady;
+		std::atomic<uint64_t>		mPublishedSequence;
+
+		std::atomic<uint64_t>		mReceived;
+		std::atomic<uint64_t>		mDropped;
+		std::atomic<uint64_t>		mFailed;
+		std::atomic<uint64_t>		mPresented;
+		std::atomic<uint64_t>		mJsonFrames;
+		std::atomic<uint64_t>		mJsonBytes;
+		std::atomic<uint64_t>		mJsonDecodeMicros;
+		std::atomic<uint64_t>		mBinaryFrames;
+		std::atomic<uint64_t>		mBinaryBytes;
+		std::atomic<uint64_t>		mBinaryDecodeMicros;
+	};
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "cinder/Cinder.h"
+
+#include "WebSocketClient.h"
+
+#include <atomic>
+#include <map>
+#include <random>
+
+namespace videodromm
+{
+	// keeps a WebSocketClient connected to the first reachable endpoint.
+	// resolving, connecting, open, backoff: every step is asynchronous on the
+	// client's io_service, so it advances inside poll() or on the network thread
+	// and never blocks update(). failed attempts move to the next endpoint and wait
+	// a jittered exponential backoff; a connection that drops after being open is
+	// retried almost immediately so a router restart is picked up quickly.
+	typedef std::shared_ptr<class VDConnectionManager> VDConnectionManagerRef;
+	class VDConnectionManager : public std::enable_shared_from_this<VDConnectionManager> {
+	public:
+		enum State { IDLE, RESOLVING, CONNECTING, OPEN, BACKOFF };
+
+		VDConnectionManager(WebSocketClient &aClient);
+		~VDConnectionManager();
+		static VDConnectionManagerRef	create(WebSocketClient &aClient)
+		{
+			return std::shared_ptr<VDConnectionManager>(new VDConnectionManager(aClient));
+		}
+		// ws:// uris tried in order, takes effect on the next attempt
+		void						setEndpoints(const std::vector<std::string> &aEndpoints);
+		void						start();
+		void						stop();
+		State						getState() const { return (State)mState.load(); };
+		static const char *			getStateName(State aState);
+		// the endpoint of the current or last attempt
+		std::string					getEndpoint() const;
+		uint64_t					getAttempts() const { return mAttempts; };
+		// forwarded from the client event handlers
+		void						onOpen();
+		void						onClose();
+		void						onFail(const std::string &aError);
+	private:
+		// backoff bounds in milliseconds
+		static const int			kBackoffMin = 100;
+		static const int			kBackoffMax = 10000;
+		// resolved addresses are reused for this long
+		static const int			kResolveCacheSeconds = 60;
+
+		struct CachedAddress {
+			std::string				address;
+			std::chrono::steady_clock::time_point	expires;
+		};
+
+		void						post(std::function<void(VDConnectionManager &)> aStep);
+		void						resolve();
+		void						connect(const std::string &aAddress);
+		void						backoff(bool aNextEndpoint);
+
+		WebSocketClient &			mClient;
+		asio::steady_timer			mTimer;
+		asio::ip::tcp::resolver		mResolver;
+		std::atomic<int>			mState;
+		// touched on the io thread only, except for the endpoint list
+		mutable std::mutex			mEndpointMutex;
+		std::vector<std::string>	mEndpoints;
+		size_t						mEndpointIndex;
+		std::string					mEndpoint;
+		std::map<std::string, CachedAddress>	mResolveCache;
+		int							mFailures;
+		std::atomic<uint64_t>		mAttempts;
+		std::mt19937				mRandom;
+	};
+}
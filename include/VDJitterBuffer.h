@@ -0,0 +1,85 @@
+#pragma once
+#include "cinder/Cinder.h"
+
+#include "VDBoundedQueue.h"
+#include "VDUniformTable.h"
+
+#include <atomic>
+#include <bitset>
+#include <vector>
+
+namespace videodromm
+{
+	// one uniform value and when it should show, steady clock microseconds
+	struct VDJitterSample {
+		uint16_t					lane;
+		float						value;
+		uint64_t					time;
+	};
+
+	// jitter buffer counters, see VDWebsocket::getJitterStats()
+	struct VDJitterStats {
+		uint64_t					samples;
+		uint64_t					overflows;	// the queue to the render thread was full
+		uint64_t					late;		// due before the previous playout, applied without interpolation
+		uint64_t					delay;		// microseconds
+	};
+
+	// smooths bursty param streams: samples are stamped with their sender time (mapped
+	// onto the local clock) or their arrival time, and the render thread plays them out
+	// a fixed delay behind, interpolating between the samples around the playout time.
+	// lanes are the uniform table floats followed by the vec4 components, all of them
+	// are interpolated in one vectorized pass per frame.
+	// the parsing thread pushes, the render thread owns the table it plays out into
+	typedef std::shared_ptr<class VDJitterBuffer> VDJitterBufferRef;
+	class VDJitterBuffer {
+	public:
+		static const size_t			kFloatLanes = VDUniformSnapshot::kSize;
+		static const size_t			kLanes = kFloatLanes * 5;
+
+		VDJitterBuffer(uint64_t aDelayMicros);
+		static VDJitterBufferRef	create(double aDelaySeconds)
+		{
+			return std::shared_ptr<VDJitterBuffer>(new VDJitterBuffer((uint64_t)(aDelaySeconds * 1000000.0)));
+		}
+		// parsing thread. aSenderTime 0 schedules by arrival time
+		void						pushFloat(unsigned int aIndex, float aValue, uint64_t aArrival, uint64_t aSenderTime = 0);
+		void						pushVec4(unsigned int aIndex, const ci::vec4 &aValue, uint64_t aArrival, uint64_t aSenderTime = 0);
+		// render thread: writes the lanes that moved at aNow - delay to aTable, the caller publishes
+		void						playout(uint64_t aNow, VDUniformTable &aTable);
+		void						setDelay(double aSeconds) { mDelay = (uint64_t)(aSeconds * 1000000.0); };
+		VDJitterStats				getStats() const;
+	private:
+		// sender clock offsets are re-estimated this often to follow drift
+		static const uint64_t		kOffsetWindow = 5000000;
+
+		uint64_t					toLocalTime(uint64_t aArrival, uint64_t aSenderTime);
+		void						push(size_t aLane, float aValue, uint64_t aTime);
+		void						interpolate();
+
+		std::atomic<uint64_t>		mDelay;
+		VDBoundedQueue<VDJitterSample>	mQueue;
+		// parsing thread: smallest arrival - sender offset, i.e. the fastest transit
+		bool						mHasOffset;
+		int64_t						mOffset;
+		int64_t						mWindowOffset;
+		uint64_t					mWindowStart;
+		// render thread
+		std::vector<VDJitterSample>	mPending;
+		uint64_t					mLastPlayout;
+		std::bitset<kLanes>			mActive;
+		std::vector<uint16_t>		mActiveLanes;
+		std::vector<uint16_t>		mChanged;
+		uint64_t					mFromTime[kLanes];
+		uint64_t					mToTime[kLanes];
+		float						mFrom[kLanes];
+		float						mTo[kLanes];
+		float						mWeight[kLanes];
+		float						mOut[kLanes];
+		float						mWritten[kLanes];
+
+		std::atomic<uint64_t>		mSamples;
+		std::atomic<uint64_t>		mOverflows;
+		std::atomic<uint64_t>		mLate;
+	};
+}
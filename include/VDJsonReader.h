@@ -0,0 +1,73 @@
+#pragma once
+#include <string>
+#include <cstring>
+
+namespace videodromm
+{
+	// non-owning view into a received payload, valid as long as the payload is
+	struct VDStringRef {
+		const char*					data;
+		size_t						size;
+
+		VDStringRef() : data(nullptr), size(0) {}
+		VDStringRef(const char *aData, size_t aSize) : data(aData), size(aSize) {}
+
+		bool						empty() const { return size == 0; }
+		bool						equals(const char *aLiteral) const {
+			size_t len = strlen(aLiteral);
+			return len == size && memcmp(data, aLiteral, len) == 0;
+		}
+		bool						startsWith(const char *aPrefix, size_t aLength) const {
+			return size >= aLength && memcmp(data, aPrefix, aLength) == 0;
+		}
+		std::string					str() const { return std::string(data, size); }
+	};
+
+	// pull-style JSON reader working in place on the payload: no DOM, no copies.
+	// the caller walks the document with beginObject/nextKey/beginArray/nextElement
+	// and reads or skips each value; any syntax error puts the reader in a failed state.
+	// members are separated by exactly one comma, a missing or extra one is a syntax error.
+	class VDJsonReader {
+	public:
+		VDJsonReader(const char *aBegin, const char *aEnd);
+		VDJsonReader(const VDStringRef &aSpan);
+
+		bool						beginObject();
+		// false when the closing '}' is reached, otherwise positioned on the value
+		bool						nextKey(VDStringRef &aKey);
+		bool						beginArray();
+		// false when the closing ']' is reached, otherwise positioned on the element
+		bool						nextElement();
+
+		// raw string content between the quotes, escapes left untouched
+		bool						readString(VDStringRef &aRaw);
+		// numbers, also accepted when quoted ("0.5") like JsonTree::getValue<float> does
+		bool						readFloat(float &aValue);
+		// false for a number outside the int range, the reader itself does not fail
+		bool						readInt(int &aValue);
+		// raw span of any value, including quotes or brackets
+		bool						readValue(VDStringRef &aSpan);
+		bool						skipValue();
+
+		char						peek();
+		bool						failed() const { return mFailed; }
+
+		// decode JSON string escapes into a reusable buffer
+		static void					unescape(const VDStringRef &aRaw, std::string &aOut);
+		// parses a float at the start of aSpan, returns the number of chars consumed
+		static size_t				parseFloat(const char *aBegin, const char *aEnd, float &aValue);
+	private:
+		const char *				mPos;
+		const char *				mEnd;
+		bool						mFailed;
+		// nothing read yet in the current object or array, no comma expected
+		bool						mFirst;
+
+		void						skipWhitespace();
+		bool						expect(char aChar);
+		bool						fail();
+		// the comma before a member that is not the first one
+		bool						separator();
+		const char *				findStringEnd(const char *aFrom);
+	};
+}
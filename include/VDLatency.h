@@ -0,0 +1,90 @@
+#pragma once
+#include "cinder/Cinder.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace videodromm
+{
+	// percentiles of one histogram, in microseconds
+	struct VDLatencySummary {
+		uint64_t					count;
+		uint64_t					p50;
+		uint64_t					p90;
+		uint64_t					p99;
+		uint64_t					p999;
+		uint64_t					max;
+		double						mean;
+	};
+
+	// hdr-style log-linear histogram of microsecond values: exact below 64,
+	// then 32 sub-buckets per power of two, about 3% relative error up to ~19 hours.
+	// recording is one relaxed increment, any thread can record while another reads
+	class VDLatencyHistogram {
+	public:
+		VDLatencyHistogram();
+		void						record(uint64_t aMicros);
+		// value at or below which aPercentile percent of the samples fall, 0 when empty
+		uint64_t					getPercentile(double aPercentile) const;
+		uint64_t					getCount() const { return mCount.load(std::memory_order_relaxed); };
+		VDLatencySummary			getSummary() const;
+		void						reset();
+	private:
+		static const unsigned int	kSubBits = 5;
+		static const unsigned int	kLinear = 64;
+		static const unsigned int	kMaxBits = 36;
+		static const size_t			kBuckets = kLinear + (kMaxBits - kSubBits - 1) * (1 << kSubBits);
+
+		static size_t				getIndex(uint64_t aMicros);
+		// largest value that lands in aIndex
+		static uint64_t				getUpperBound(size_t aIndex);
+
+		std::atomic<uint64_t>		mBuckets[kBuckets];
+		std::atomic<uint64_t>		mCount;
+		std::atomic<uint64_t>		mSum;
+		std::atomic<uint64_t>		mMax;
+	};
+
+	// end-to-end latency per message type: from the socket read in onMessage to
+	// parsed (canvas: decoded), to picked up by the render thread, to the frame that
+	// showed it being sent out. timestamps are steady clock microseconds
+	typedef std::shared_ptr<class VDLatencyTracker> VDLatencyTrackerRef;
+	class VDLatencyTracker {
+	public:
+		enum Type { UNIFORMS, CANVAS, SHADER, OTHER, TYPE_COUNT };
+		enum Stage { PARSED, APPLIED, PRESENTED, STAGE_COUNT };
+
+		VDLatencyTracker();
+		static VDLatencyTrackerRef	create()
+		{
+			return std::shared_ptr<VDLatencyTracker>(new VDLatencyTracker());
+		}
+		static uint64_t				now()
+		{
+			return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+		static uint64_t				toMicros(std::chrono::steady_clock::time_point aTime)
+		{
+			return std::chrono::duration_cast<std::chrono::microseconds>(aTime.time_since_epoch()).count();
+		}
+		static const char *			getTypeName(Type aType);
+		static const char *			getStageName(Stage aStage);
+
+		// aReceived 0 is ignored, e.g. a uniform snapshot without changes
+		void						record(Type aType, Stage aStage, uint64_t aReceived, uint64_t aNow);
+		void						record(Type aType, Stage aStage, uint64_t aReceived) { record(aType, aStage, aReceived, now()); };
+		const VDLatencyHistogram &	getHistogram(Type aType, Stage aStage) const { return mHistograms[aType][aStage]; };
+		VDLatencySummary			getSummary(Type aType, Stage aStage) const { return mHistograms[aType][aStage].getSummary(); };
+		void						reset();
+
+		// render thread: write every histogram with samples to the log every aSeconds, 0 disables
+		void						setLogInterval(double aSeconds) { mLogInterval = aSeconds; };
+		void						update(double aElapsedSeconds);
+		std::string					getReport() const;
+	private:
+		VDLatencyHistogram			mHistograms[TYPE_COUNT][STAGE_COUNT];
+		double						mLogInterval;
+		double						mLastLog;
+	};
+}
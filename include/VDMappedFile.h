@@ -0,0 +1,37 @@
+#pragma once
+#include "cinder/Cinder.h"
+
+namespace videodromm
+{
+	// memory-mapped file, read-only or growable for appending.
+	// used by the traffic recorder and replayer so captures of several
+	// gigabytes are neither copied nor read through a stream.
+	class VDMappedFile {
+	public:
+		VDMappedFile();
+		~VDMappedFile();
+		bool						openRead(const ci::fs::path &aPath);
+		// creates or truncates the file and maps aSize bytes
+		bool						openWrite(const ci::fs::path &aPath, size_t aSize);
+		// write mode: grows the file and remaps it, getData() may change
+		bool						resize(size_t aSize);
+		// write mode: the file is truncated to aUsedSize bytes
+		void						close(size_t aUsedSize = 0);
+		bool						isOpen() const { return mData != nullptr; };
+		uint8_t *					getData() const { return mData; };
+		size_t						getSize() const { return mSize; };
+	private:
+		bool						map(size_t aSize);
+		void						unmap();
+
+		uint8_t *					mData;
+		size_t						mSize;
+		bool						mWritable;
+#if defined( CINDER_MSW )
+		void *						mFile;
+		void *						mMapping;
+#else
+		int							mFile;
+#endif
+	};
+}
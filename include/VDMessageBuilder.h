@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace videodromm
+{
+	// writes outbound json into one reusable buffer. every top-level object is a
+	// message, messages written during a frame are sent together as a json array
+	// (a single message is sent on its own), see VDWebsocket::flush().
+	// not thread-safe, commands are issued and flushed on the render thread.
+	class VDMessageBuilder {
+	public:
+		VDMessageBuilder(size_t aReserve = 4096);
+		void						beginObject();
+		void						endObject();
+		void						beginArray();
+		void						endArray();
+		void						key(const char *aKey);
+		void						value(int64_t aValue);
+		void						value(int aValue) { value((int64_t)aValue); };
+		void						value(unsigned int aValue) { value((int64_t)aValue); };
+		void						value(double aValue);
+		void						value(bool aValue);
+		// escaped
+		void						value(const char *aValue, size_t aSize);
+		void						value(const char *aValue);
+		void						value(const std::string &aValue) { value(aValue.data(), aValue.size()); };
+		// an already serialized json value, e.g. a whole message
+		void						raw(const char *aJson, size_t aSize);
+		void						raw(const std::string &aJson) { raw(aJson.data(), aJson.size()); };
+
+		size_t						getMessageCount() const { return mMessageCount; };
+		bool						empty() const { return mMessageCount == 0; };
+		// the frame to send, valid until clear()
+		const std::string &			finish();
+		// keeps the buffer capacity
+		void						clear();
+	private:
+		static const int			kMaxDepth = 32;
+		// comma before the next value at this depth
+		void						separate();
+		void						escape(const char *aValue, size_t aSize);
+		void						endValue();
+
+		std::string					mBuffer;
+		size_t						mMessageCount;
+		int							mDepth;
+		bool						mHasValue[kMaxDepth];
+		bool						mAfterKey;
+	};
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "cinder/Cinder.h"
+
+#include "WebSocketConnection.h"
+
+#include "VDCanvasDecoder.h"
+#include "VDJitterBuffer.h"
+#include "VDLatency.h"
+#include "VDOscReceiver.h"
+#include "VDShaderPatcher.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace videodromm
+{
+	// one source of a VDMetricsSnapshot
+	struct VDMetricsSource {
+		bool						connected;
+		WebSocketStats				connection;
+		VDCanvasStats				canvas;
+		VDJitterStats				jitter;
+	};
+
+	// what /metrics and /stats report. filled by the render thread, never modified once published
+	struct VDMetricsSnapshot {
+		double						uptime;
+		uint64_t					frames;
+		// frame to frame time since the previous snapshot, in microseconds
+		VDLatencySummary			frameTime;
+		VDLatencySummary			latency[VDLatencyTracker::TYPE_COUNT][VDLatencyTracker::STAGE_COUNT];
+		std::vector<VDMetricsSource>	sources;
+		uint64_t					inboxDropped;
+		uint64_t					unhandledMessages;
+		VDOscReceiverStats			osc;
+		VDShaderPatchStats			shaderPatches;
+		// set by the app, e.g. warp mesh rebuilds, see VDWebsocket::setMetric()
+		std::map<std::string, double>	custom;
+	};
+	typedef std::shared_ptr<const VDMetricsSnapshot> VDMetricsSnapshotRef;
+
+	// frame times and the last published snapshot. requests are rendered from the
+	// snapshot on the network thread, publishing only swaps a shared_ptr so a scrape
+	// never waits for the render thread and the render thread never waits for a scrape
+	class VDMetrics {
+	public:
+		VDMetrics();
+		// render thread, once per presented frame
+		void						frame(uint64_t aNow);
+		// render thread: adds the frame times recorded since the previous publish and swaps aSnapshot in
+		void						publish(const std::shared_ptr<VDMetricsSnapshot> &aSnapshot);
+		VDMetricsSnapshotRef		getSnapshot() const { return std::atomic_load(&mSnapshot); };
+		// prometheus text exposition format
+		static std::string			renderPrometheus(const VDMetricsSnapshot &aSnapshot);
+		static std::string			renderJson(const VDMetricsSnapshot &aSnapshot);
+		// any thread: "/metrics" or "/stats", false for anything else
+		bool						handleRequest(const std::string &aResource, std::string &aContentType, std::string &aBody) const;
+	private:
+		VDLatencyHistogram			mFrameTimes;
+		uint64_t					mLastFrame;
+		uint64_t					mFrames;
+		VDMetricsSnapshotRef		mSnapshot;
+	};
+}
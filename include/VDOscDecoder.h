@@ -0,0 +1,60 @@
+#pragma once
+#include "VDJsonReader.h"
+
+#include <cstdint>
+#include <functional>
+
+namespace videodromm
+{
+	// one decoded osc argument, strings and blobs point into the packet
+	struct VDOscArgument {
+		// osc type tag: i f s S b h t d c r m T F N I
+		char						type;
+		int32_t						i;
+		int64_t						h;
+		float						f;
+		double						d;
+		VDStringRef					s;
+		// numeric and boolean arguments as a float, false for strings, blobs and nil
+		bool						toFloat(float &aValue) const;
+		// false as well for values outside the int range, nan and inf
+		bool						toInt(int &aValue) const;
+	};
+
+	// an osc message inside a packet, arguments are decoded on demand
+	class VDOscMessage {
+	public:
+		VDOscMessage() : timetag(1), mTypeTags(nullptr), mTypeTagsEnd(nullptr), mData(nullptr), mEnd(nullptr), mFailed(false) {}
+		VDStringRef					address;
+		// of the enclosing bundle, 1 means immediately
+		uint64_t					timetag;
+		size_t						getArgumentCount() const { return mTypeTagsEnd - mTypeTags; };
+		// walks the arguments in order, false at the end or on a truncated message
+		bool						nextArgument(VDOscArgument &aArgument);
+		bool						failed() const { return mFailed; };
+	private:
+		friend class VDOscDecoder;
+		const char *				mTypeTags;
+		const char *				mTypeTagsEnd;
+		const uint8_t *				mData;
+		const uint8_t *				mEnd;
+		bool						mFailed;
+	};
+
+	// zero-copy OSC 1.0 decoder: messages and nested bundles are read in place,
+	// nothing is allocated or copied
+	class VDOscDecoder {
+	public:
+		typedef std::function<void(VDOscMessage &aMessage)> Handler;
+		// true if the data starts like an osc packet ("/" or "#bundle")
+		static bool					isPacket(const void *aData, size_t aSize);
+		// calls aHandler for every message, bundle elements in order.
+		// returns false on a malformed packet, messages before the error are delivered
+		static bool					decode(const void *aData, size_t aSize, const Handler &aHandler);
+		// OSC 1.0 address pattern matching: ? * [abc] [a-z] [!a] {foo,bar}. patterns needing
+		// more characters than aAddress has, or with more than 4 runs of '*' and {} groups, don't match
+		static bool					match(const VDStringRef &aPattern, const VDStringRef &aAddress);
+	private:
+		static bool					decodePacket(const uint8_t *aData, size_t aSize, uint64_t aTimetag, int aDepth, const Handler &aHandler);
+	};
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "cinder/Cinder.h"
+
+#include "asio.hpp"
+
+#include <atomic>
+#include <functional>
+
+namespace videodromm
+{
+	// one datagram of a receive batch, only valid inside the handler
+	struct VDOscDatagram {
+		const uint8_t *				data;
+		size_t						size;
+	};
+
+	// receive counters, see VDWebsocket::getOscReceiverStats()
+	struct VDOscReceiverStats {
+		uint64_t					packets;
+		uint64_t					bytes;
+		uint64_t					batches;
+		uint64_t					truncated;	// larger than a slot, dropped
+		uint64_t					errors;		// failed receives, each one delays the next wait
+	};
+
+	// udp osc listener on an io_service it shares with the websocket clients, so
+	// controllers can skip the nodejs router. the socket is only waited on for
+	// readability, then drained in batches: recvmmsg on linux, non-blocking
+	// receives elsewhere. the handler gets the whole batch at once, in place.
+	typedef std::shared_ptr<class VDOscReceiver> VDOscReceiverRef;
+	class VDOscReceiver : public std::enable_shared_from_this<VDOscReceiver> {
+	public:
+		typedef std::function<void(const VDOscDatagram *aDatagrams, size_t aCount)>	Handler;
+
+		VDOscReceiver(asio::io_service &aIoService, const Handler &aHandler);
+		~VDOscReceiver();
+		static VDOscReceiverRef		create(asio::io_service &aIoService, const Handler &aHandler)
+		{
+			return std::shared_ptr<VDOscReceiver>(new VDOscReceiver(aIoService, aHandler));
+		}
+		// binds right away, receiving starts on the io thread. false if the port is taken
+		bool						open(uint16_t aPort, const std::string &aAddress = "0.0.0.0");
+		void						close();
+		bool						isOpen() const { return mOpen; };
+		uint16_t					getPort() const { return mPort; };
+		VDOscReceiverStats			getStats() const;
+	private:
+		// datagrams per batch and bytes per datagram
+		static const size_t			kBatchSize = 32;
+		static const size_t			kSlotSize = 8192;
+		// after a receive error the next wait is delayed, doubling from kRetryMin to kRetryMax milliseconds
+		static const int			kRetryMin = 10;
+		static const int			kRetryMax = 1000;
+
+		void						wait();
+		void						drain();
+		// aError is set for errors other than would block and connection reset
+		size_t						receiveBatch(asio::error_code &aError);
+
+		asio::io_service &			mIoService;
+		asio::ip::udp::socket		mSocket;
+		asio::steady_timer			mRetryTimer;
+		int							mRetryDelay;
+		Handler						mHandler;
+		std::atomic<bool>			mOpen;
+		uint16_t					mPort;
+		// kBatchSize slots of kSlotSize bytes
+		std::vector<uint8_t>		mBuffer;
+		VDOscDatagram				mDatagrams[kBatchSize];
+		std::atomic<uint64_t>		mPackets;
+		std::atomic<uint64_t>		mBytes;
+		std::atomic<uint64_t>		mBatches;
+		std::atomic<uint64_t>		mTruncated;
+		std::atomic<uint64_t>		mErrors;
+	};
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "VDOscDecoder.h"
+
+#include <string>
+#include <vector>
+
+namespace videodromm
+{
+	// routes decoded osc messages to handlers by address. incoming addresses may be
+	// osc patterns, they are matched against every route; plain addresses take a
+	// length and memcmp test per route. not thread safe, like VDPrefixDispatcher:
+	// only the thread dispatching packets may change it, VDWebsocket posts its
+	// changes onto the io_service.
+	class VDOscRouter {
+	public:
+		typedef VDOscDecoder::Handler Handler;
+
+		// replaces an existing route for the same address
+		void						addRoute(const std::string &aAddress, const Handler &aHandler);
+		void						removeRoute(const std::string &aAddress);
+		// returns the number of routes the message matched
+		size_t						dispatch(const VDOscMessage &aMessage) const;
+	private:
+		struct Route {
+			std::string				address;
+			Handler					handler;
+		};
+		std::vector<Route>			mRoutes;
+	};
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "VDJsonReader.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace videodromm
+{
+	typedef std::function<void(const VDStringRef &aMessage)> VDPrefixHandler;
+
+	// routes text messages to handlers by prefix without allocating.
+	// entries are bucketed by first byte, a bucket is sorted longest prefix first
+	// so "/*" wins over "/". not thread safe: only the thread parsing messages may
+	// change it, VDWebsocket posts its changes onto the io_service.
+	class VDPrefixDispatcher {
+	public:
+		// replaces an existing handler for the same prefix
+		void						addHandler(const std::string &aPrefix, const VDPrefixHandler &aHandler);
+		void						removeHandler(const std::string &aPrefix);
+		// false when no prefix matched
+		bool						dispatch(const VDStringRef &aMessage) const;
+	private:
+		struct Entry {
+			std::string				prefix;
+			VDPrefixHandler			handler;
+		};
+		std::vector<Entry>			mBuckets[256];
+	};
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "cinder/Cinder.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace videodromm
+{
+	// persists received shaders under glsl/received and glsl/processed without
+	// touching the disk on the calling thread. writes are queued for a writer
+	// thread which checks the folders once, coalesces rewrites of the same file
+	// and syncs each batch of files to disk together.
+	typedef std::shared_ptr<class VDShaderArchive> VDShaderArchiveRef;
+	class VDShaderArchive {
+	public:
+		enum Folder { RECEIVED, PROCESSED };
+
+		VDShaderArchive(const ci::fs::path &aRoot);
+		~VDShaderArchive();
+		static VDShaderArchiveRef	create(const ci::fs::path &aRoot)
+		{
+			return std::shared_ptr<VDShaderArchive>(new VDShaderArchive(aRoot));
+		}
+		// never blocks on the disk, a pending write of the same file is replaced
+		void						write(Folder aFolder, const std::string &aFileName, const std::string &aContent);
+		uint64_t					getWritten() const { return mWritten; };
+		// queue full or the file could not be written
+		uint64_t					getDropped() const { return mDropped; };
+	private:
+		struct Job {
+			Folder					folder;
+			std::string				fileName;
+			std::string				content;
+		};
+		// time to gather a burst of edits into one batch
+		static const int			kBatchMilliseconds = 100;
+		static const size_t			kMaxPending = 64;
+
+		void						writerLoop();
+		void						writeBatch(std::deque<Job> &aBatch);
+
+		ci::fs::path				mRoot;
+		std::thread					mWriter;
+		std::mutex					mMutex;
+		std::condition_variable		mCondition;
+		bool						mRunning;
+		std::deque<Job>				mPending;
+		std::atomic<uint64_t>		mWritten;
+		std::atomic<uint64_t>		mDropped;
+	};
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "cinder/Cinder.h"
+
+#include <atomic>
+#include <list>
+#include <unordered_map>
+
+namespace videodromm
+{
+	// a received shader after preprocessing
+	struct VDProcessedShader {
+		// from the /* json */ header, empty for frag and hydra messages
+		std::string					title;
+		// false when #include shadertoy.inc was injected
+		bool						hasUniforms;
+		std::string					content;
+	};
+	typedef std::shared_ptr<const VDProcessedShader> VDProcessedShaderRef;
+
+	// see VDWebsocket::getShaderCacheStats()
+	struct VDShaderCacheStats {
+		// payloads identical to the previous one of their kind, dropped before any copy
+		uint64_t					repeats;
+		// processed results found in or missing from the lru
+		uint64_t					hits;
+		uint64_t					misses;
+	};
+
+	// content-addressed cache for shader messages. hydra resends the whole source
+	// on every edit: payloads are hashed as received (still escaped) so an
+	// unchanged shader is recognized before it is copied, unescaped or parsed,
+	// and recently processed shaders come back from an lru without redoing the work.
+	// the lru is shared, repeats are detected against a History kept per sender.
+	// used by the thread parsing messages only, the counters can be read from any thread.
+	typedef std::shared_ptr<class VDShaderCache> VDShaderCacheRef;
+	class VDShaderCache {
+	public:
+		enum Kind { FRAG, HYDRA, HEADER, KIND_COUNT };
+		// the last payload of each kind from one sender
+		struct History {
+			History();
+			uint64_t				hash[KIND_COUNT];
+			size_t					size[KIND_COUNT];
+		};
+
+		VDShaderCache(size_t aCapacity);
+		static VDShaderCacheRef		create(size_t aCapacity = 32)
+		{
+			return std::shared_ptr<VDShaderCache>(new VDShaderCache(aCapacity));
+		}
+		// 64 bit MurmurHash2 (MurmurHash64A)
+		static uint64_t				hash(const char *aData, size_t aSize);
+		// true when the payload is the same as the last one of its kind, otherwise it becomes the last one
+		bool						isRepeat(History &aHistory, Kind aKind, uint64_t aHash, size_t aSize);
+		// the current shader of aKind changed without a full payload, e.g. through a patch
+		static void					forgetLast(History &aHistory, Kind aKind);
+		// most recently used entries are kept, find() refreshes an entry
+		VDProcessedShaderRef		find(Kind aKind, uint64_t aHash);
+		void						insert(Kind aKind, uint64_t aHash, const VDProcessedShaderRef &aShader);
+		VDShaderCacheStats			getStats() const;
+	private:
+		typedef std::list<std::pair<uint64_t, VDProcessedShaderRef>> Entries;
+		static uint64_t				key(Kind aKind, uint64_t aHash) { return aHash ^ ((uint64_t)aKind * 0x9E3779B97F4A7C15ULL); }
+
+		size_t						mCapacity;
+		Entries						mEntries;
+		std::unordered_map<uint64_t, Entries::iterator>	mIndex;
+		std::atomic<uint64_t>		mRepeats;
+		std::atomic<uint64_t>		mHits;
+		std::atomic<uint64_t>		mMisses;
+	};
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "cinder/Cinder.h"
+
+#include "VDJsonReader.h"
+#include "VDShaderCache.h"
+
+#include <atomic>
+
+namespace videodromm
+{
+	// see VDWebsocket::getShaderPatchStats()
+	struct VDShaderPatchStats {
+		uint64_t					applied;
+		// wrong base version or a splice out of range, a full resend was requested
+		uint64_t					rejected;
+		// splice text received vs full text delivered
+		uint64_t					patchBytes;
+		uint64_t					textBytes;
+	};
+
+	// the last known text of the frag and hydra shaders and its version, so an edit
+	// can be sent as splices against it instead of the whole source. a patch only
+	// applies to the exact version it was made from. the splices go into a copy, a
+	// failed patch leaves the text as it was but refuses patches until the next full message.
+	// used by the thread parsing messages only, the counters can be read from any thread.
+	class VDShaderPatcher {
+	public:
+		VDShaderPatcher();
+		// after a full message. version 0 means unversioned, patches are refused until a versioned one
+		void						setText(VDShaderCache::Kind aKind, int aVersion, const std::string &aText);
+		// a full message identical to the current text
+		void						setVersion(VDShaderCache::Kind aKind, int aVersion) { mVersion[aKind] = aVersion; };
+		// aSplices: [[offset, erase, "insert"], ...] in bytes, each offset into the text left by the previous splice
+		bool						apply(VDShaderCache::Kind aKind, int aBase, int aVersion, const VDStringRef &aSplices);
+		const std::string &			getText(VDShaderCache::Kind aKind) const { return mText[aKind]; };
+		int							getVersion(VDShaderCache::Kind aKind) const { return mVersion[aKind]; };
+		VDShaderPatchStats			getStats() const;
+	private:
+		bool						splice(std::string &aText, VDJsonReader &aReader);
+
+		std::string					mText[VDShaderCache::KIND_COUNT];
+		int							mVersion[VDShaderCache::KIND_COUNT];
+		// the text being patched and the unescaped splice text, reused
+		std::string					mScratch;
+		std::string					mInsert;
+		std::atomic<uint64_t>		mApplied;
+		std::atomic<uint64_t>		mRejected;
+		std::atomic<uint64_t>		mPatchBytes;
+		std::atomic<uint64_t>		mTextBytes;
+	};
+}
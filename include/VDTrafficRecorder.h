@@ -0,0 +1,53 @@
+#pragma once
+#include "cinder/Cinder.h"
+
+#include "VDMappedFile.h"
+
+#include <chrono>
+#include <mutex>
+
+namespace videodromm
+{
+	// capture file layout, native (little-endian) byte order:
+	// a 16 byte file header "HYDT", version (uint32), used length (uint64),
+	// then one record per inbound message: receive time in microseconds since
+	// the capture started (uint64), payload size (uint32), websocket opcode (uint8),
+	// source id (uint8), 2 reserved bytes, followed by the payload.
+	// the used length is updated after every record, so a capture cut short
+	// by a crash is still readable up to its last complete message.
+	struct VDTrafficCapture {
+		static const uint32_t		kVersion = 1;
+		static const size_t			kHeaderSize = 16;
+		static const size_t			kRecordHeaderSize = 16;
+		// websocket opcodes
+		enum Opcode { TEXT = 1, BINARY = 2 };
+	};
+
+	// appends inbound websocket messages to a memory-mapped capture file,
+	// see VDTrafficReplayer to feed it back through the parser
+	typedef std::shared_ptr<class VDTrafficRecorder> VDTrafficRecorderRef;
+	class VDTrafficRecorder {
+	public:
+		VDTrafficRecorder(const ci::fs::path &aPath);
+		~VDTrafficRecorder();
+		static VDTrafficRecorderRef	create(const ci::fs::path &aPath)
+		{
+			return std::shared_ptr<VDTrafficRecorder>(new VDTrafficRecorder(aPath));
+		}
+		bool						isOpen() const { return mFile.isOpen(); };
+		// called from the thread receiving messages
+		void						record(uint8_t aOpcode, uint8_t aSource, const void *aData, size_t aSize);
+		uint64_t					getMessageCount() const { return mMessageCount; };
+		// file size without the zeroed tail reserved for the next messages
+		uint64_t					getBytesWritten() const { return mUsed; };
+	private:
+		// the file grows by at least this much when it is full
+		static const size_t			kGrowSize = 64 * 1024 * 1024;
+
+		std::mutex					mMutex;
+		VDMappedFile				mFile;
+		size_t						mUsed;
+		uint64_t					mMessageCount;
+		std::chrono::steady_clock::time_point	mStart;
+	};
+}
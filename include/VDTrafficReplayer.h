@@ -0,0 +1,47 @@
+#pragma once
+#include "cinder/Cinder.h"
+
+#include "VDTrafficRecorder.h"
+
+#include <atomic>
+#include <functional>
+
+namespace videodromm
+{
+	// see VDWebsocket::timeReplay()
+	struct VDReplayTiming {
+		// text messages starting with '{', other text messages, binary messages
+		enum Kind { JSON, TEXT, BINARY, KIND_COUNT };
+		uint64_t					messages[KIND_COUNT];
+		uint64_t					bytes[KIND_COUNT];
+		// wall time spent in the parser
+		uint64_t					nanos[KIND_COUNT];
+	};
+
+	// plays a capture written by VDTrafficRecorder back into a message handler,
+	// straight from the mapped file: no socket and no copy of the payloads.
+	typedef std::shared_ptr<class VDTrafficReplayer> VDTrafficReplayerRef;
+	class VDTrafficReplayer {
+	public:
+		typedef std::function<void(uint8_t aOpcode, uint8_t aSource, const void *aData, size_t aSize)> Handler;
+
+		VDTrafficReplayer(const ci::fs::path &aPath);
+		static VDTrafficReplayerRef	create(const ci::fs::path &aPath)
+		{
+			return std::shared_ptr<VDTrafficReplayer>(new VDTrafficReplayer(aPath));
+		}
+		bool						isOpen() const { return mFile.isOpen(); };
+		uint64_t					getMessageCount() const { return mMessageCount; };
+		// capture length in seconds
+		double						getDuration() const { return mDuration / 1000000.0; };
+		// aSpeed 1 replays with the recorded timing, N is N times faster, 0 as fast as possible.
+		// blocks until the capture ends or aCancel is set, returns the messages delivered
+		uint64_t					replay(float aSpeed, const Handler &aHandler, const std::atomic<bool> &aCancel);
+	private:
+		VDMappedFile				mFile;
+		// end of the last complete record
+		size_t						mUsed;
+		uint64_t					mMessageCount;
+		uint64_t					mDuration;
+	};
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "cinder/Cinder.h"
+
+#include "VDJsonReader.h"
+
+#include <map>
+#include <vector>
+
+namespace videodromm
+{
+	// typed view of the hydra uniforms payload, {"time":1.5,"resolution":[1280,720],...},
+	// laid out std140 so getData() can go to a uniform buffer in one upload.
+	// numbers and booleans become floats, arrays of 2 to 4 numbers vecN; other values are ignored.
+	// the layout is keyed by a hash of the names and types: a payload with the same
+	// shape as the previous one only has its values written in place, names are
+	// compared against the cached layout but never copied and nothing is reallocated.
+	// render thread only
+	class VDUniformBlock {
+	public:
+		enum Type { FLOAT = 1, VEC2 = 2, VEC3 = 3, VEC4 = 4 };
+		struct Entry {
+			std::string				name;
+			Type					type;
+			uint32_t				offset;
+		};
+
+		VDUniformBlock();
+		// false if aJson is not an object, the previous values are kept
+		bool						update(const VDStringRef &aJson);
+		const std::vector<Entry> &	getEntries() const;
+		// nullptr if there is no such uniform
+		const Entry *				find(const std::string &aName) const;
+		float						getFloat(const Entry &aEntry, int aComponent = 0) const;
+		// std140 data, getSize() is a multiple of 16
+		const uint8_t *				getData() const { return mData.data(); };
+		size_t						getSize() const { return mData.size(); };
+		uint64_t					getLayoutHash() const { return mLayout ? mLayout->hash : 0; };
+		// bumped on every update, compare to know when to upload
+		uint64_t					getVersion() const { return mVersion; };
+		// "layout(std140) uniform aName { float time; vec2 resolution; ... };"
+		std::string					getDeclaration(const std::string &aName) const;
+		// payloads written in place vs the ones that needed a new or cached layout
+		uint64_t					getInPlaceUpdates() const { return mInPlaceUpdates; };
+		uint64_t					getLayoutChanges() const { return mLayoutChanges; };
+	private:
+		// layouts seen before are kept, hydra switches between a few shapes
+		static const size_t			kMaxLayouts = 8;
+
+		struct Layout {
+			std::vector<Entry>		entries;
+			size_t					size;
+			uint64_t				hash;
+		};
+		typedef std::shared_ptr<const Layout> LayoutRef;
+
+		// reads the next value, false if it is not a uniform. aCount is its number of components
+		static bool					readValue(VDJsonReader &aReader, float *aValues, int &aCount);
+		// writes the values of aJson if it has exactly the shape of aLayout
+		bool						fill(const VDStringRef &aJson, const Layout &aLayout);
+		LayoutRef					buildLayout(const VDStringRef &aJson);
+
+		LayoutRef					mLayout;
+		std::map<uint64_t, LayoutRef>	mLayouts;
+		std::vector<uint8_t>		mData;
+		uint64_t					mVersion;
+		uint64_t					mInPlaceUpdates;
+		uint64_t					mLayoutChanges;
+	};
+}
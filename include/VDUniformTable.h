@@ -0,0 +1,62 @@
+#pragma once
+#include "cinder/Cinder.h"
+#include "cinder/Vector.h"
+
+#include <atomic>
+#include <bitset>
+
+namespace videodromm
+{
+	// one published state of the uniform table. dirty bits cover every lane
+	// changed since the previous snapshot the render thread picked up.
+	struct VDUniformSnapshot {
+		static const size_t			kSize = 256;
+		float						floats[kSize];
+		ci::vec4					vec4s[kSize];
+		std::bitset<kSize>			floatDirty;
+		std::bitset<kSize>			vec4Dirty;
+		uint64_t					version;
+		// receive time of the oldest change in the dirty lanes, steady clock microseconds
+		uint64_t					received;
+	};
+
+	// fixed-size, index-addressed uniform store fed by params and k2 messages.
+	// a single writer (the thread parsing messages) sets values and publishes
+	// them; the render thread swaps in the latest snapshot once per frame.
+	// the snapshot exchange is a lock-free triple buffer, so bursts of controller
+	// updates collapse into one upload per frame.
+	typedef std::shared_ptr<class VDUniformTable> VDUniformTableRef;
+	class VDUniformTable {
+	public:
+		VDUniformTable();
+		static VDUniformTableRef	create()
+		{
+			return std::shared_ptr<VDUniformTable>(new VDUniformTable());
+		}
+		// writer. changes made after this are stamped with aMicros, see VDUniformSnapshot::received
+		void						setReceiveTime(uint64_t aMicros) { mReceiveTime = aMicros; };
+		void						setFloat(unsigned int aIndex, float aValue);
+		void						setVec4(unsigned int aIndex, const ci::vec4 &aValue);
+		float						getFloat(unsigned int aIndex) const { return aIndex < VDUniformSnapshot::kSize ? mWorking.floats[aIndex] : 0.0f; }
+		// makes the pending changes visible to the render thread, no-op when nothing changed
+		void						publish();
+		// render thread: true if a newer snapshot was swapped in
+		bool						swap();
+		const VDUniformSnapshot &	getSnapshot() const { return mBuffers[mReadIndex]; }
+	private:
+		static const unsigned int	kFresh = 4;
+		static const unsigned int	kIndexMask = 3;
+
+		VDUniformSnapshot			mWorking;
+		std::bitset<VDUniformSnapshot::kSize>	mUnconsumedFloat;
+		std::bitset<VDUniformSnapshot::kSize>	mUnconsumedVec4;
+		uint64_t					mVersion;
+		uint64_t					mReceiveTime;
+		uint64_t					mUnconsumedReceived;
+		VDUniformSnapshot			mBuffers[3];
+		unsigned int				mWriteIndex;
+		unsigned int				mReadIndex;
+		std::atomic<unsigned int>	mMiddle;
+		std::atomic<uint64_t>		mConsumedVersion;
+	};
+}
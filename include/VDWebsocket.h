@@ -7,6 +7,36 @@
 // WebSockets
 #include "WebSocketClient.h"
 #include "WebSocketServer.h"
+// JSON
+#include "VDJsonReader.h"
+// Text messages
+#include "VDPrefixDispatcher.h"
+#include "VDMessageBuilder.h"
+// OSC
+#include "VDOscRouter.h"
+#include "VDOscReceiver.h"
+// Canvas
+#include "VDCanvasDecoder.h"
+// Uniforms
+#include "VDUniformTable.h"
+#include "VDJitterBuffer.h"
+#include "VDUniformBlock.h"
+// Inbox
+#include "VDBoundedQueue.h"
+// Shaders
+#include "VDShaderCache.h"
+#include "VDShaderArchive.h"
+#include "VDShaderPatcher.h"
+// Connection
+#include "VDConnectionManager.h"
+// Latency
+#include "VDLatency.h"
+#include "VDMetrics.h"
+// Capture
+#include "VDTrafficRecorder.h"
+#include "VDTrafficReplayer.h"
+
+#include <thread>
 
 
 using namespace ci;
@@ -17,24 +47,103 @@ using namespace asio;
 
 namespace videodromm
 {
+	// parsed results handed from the network thread to update()
+	struct VDWebsocketEvent {
+		enum Type { SHADER, UNIFORMS };
+		Type						type;
+		string						payload;
+		// steady clock microseconds the message was read
+		uint64_t					received;
+	};
+
+	// one hydra instance: its connection and the channels its canvas and params are routed to
+	struct VDWebsocketSource {
+		unsigned int				id;
+		std::unique_ptr<WebSocketClient>	client;
+		// after client, its timers are cancelled first
+		VDConnectionManagerRef		connection;
+		std::atomic<bool>			connected;
+		VDCanvasDecoderRef			canvasDecoder;
+		VDUniformTableRef			uniforms;
+		bool						uniformsChanged;
+		// when set, params go through it and the render thread writes uniforms
+		VDJitterBufferRef			jitter;
+		// versions and repeats only mean something for the sender they came from
+		VDShaderCache::History		shaderHistory;
+		VDShaderPatcher				shaderPatcher;
+	};
+	typedef std::shared_ptr<VDWebsocketSource> VDWebsocketSourceRef;
+
 	// stores the pointer to the VDWebsocket instance
 	typedef std::shared_ptr<class VDWebsocket> VDWebsocketRef;
 	class VDWebsocket {
 	public:
 		VDWebsocket();
+		~VDWebsocket();
 		static VDWebsocketRef	create()
 		{
 			return shared_ptr<VDWebsocket>(new VDWebsocket());
 		}
 		void						update();
-		// messages
+		// run the websocket io loop and parseMessage on a dedicated thread,
+		// update() then only drains the inbox instead of polling the socket
+		void						startNetworkThread();
+		void						stopNetworkThread();
+		bool						isNetworkThreaded() const { return mNetworkThreaded; };
+		// events lost because the inbox was full
+		uint64_t					getInboxDropped() const { return mInboxDropped; };
+		// messages, queued until flush()
 		void						sendJSON(string params);
+		// send the commands of this frame as a single message, call once at the end of the frame
+		void						flush();
 		void						updateParams(int iarg0, float farg1);
 		// WebSockets
 		//void						wsWriteBinary(const void *data, int size);
 		void						wsWrite(std::string msg);
 		void						wsConnect();
 		void						wsPing();
+		// another hydra instance, served by the same io_service as the others.
+		// returns its source id, source 0 is the default router. render thread only
+		unsigned int				addSource(const vector<string> &aEndpoints);
+		size_t						getSourceCount() const { return mSources.size(); };
+		// router uris tried in order, defaults to ws://127.0.0.1:8088
+		void						setEndpoints(const vector<string> &aEndpoints, unsigned int aSource = 0);
+		VDConnectionManager::State	getConnectionState(unsigned int aSource = 0) const { return getSource(aSource).connection->getState(); };
+		bool						isConnected(unsigned int aSource = 0) const { return getSource(aSource).connected; };
+		// handle text messages starting with aPrefix, the longest matching prefix wins.
+		// replaces the handler already registered for that prefix, e.g. "/" for osc.
+		// applied on the io_service, before the next message it parses
+		void						addMessageHandler(const string &aPrefix, const VDPrefixHandler &aHandler);
+		void						removeMessageHandler(const string &aPrefix);
+		// osc messages to aAddress set uniform aUniform from their first numeric argument,
+		// e.g. addOscRoute("/1/fader1", 1). /params (name, value pairs) and /k2 (name, x, y, z, w) are built in.
+		// applied on the io_service, before the next packet it parses
+		void						addOscRoute(const string &aAddress, unsigned int aUniform);
+		void						addOscHandler(const string &aAddress, const VDOscRouter::Handler &aHandler);
+		void						removeOscRoute(const string &aAddress);
+		// osc straight from controllers over udp, parsed like the "/" messages of aSource.
+		// served by the websocket io_service, polled in update() or on the network thread
+		bool						startOscReceiver(uint16_t aPort, unsigned int aSource = 0);
+		void						stopOscReceiver();
+		bool						isOscReceiving() const { return mOscReceiver && mOscReceiver->isOpen(); };
+		VDOscReceiverStats			getOscReceiverStats() const { return mOscReceiver ? mOscReceiver->getStats() : VDOscReceiverStats(); };
+		// append every inbound message to a capture file
+		bool						startRecording(const fs::path &aPath);
+		void						stopRecording();
+		bool						isRecording() const { return std::atomic_load(&mRecorder) != nullptr; };
+		// feed a capture through the parser instead of the socket. aSpeed 1 keeps the
+		// recorded timing, N is N times faster, 0 as fast as possible.
+		// live messages are ignored until the replay ends or stopReplay() is called
+		bool						startReplay(const fs::path &aPath, float aSpeed = 1.0f);
+		void						stopReplay();
+		bool						isReplaying() const { return mReplaying; };
+		uint64_t					getReplayedMessages() const { return mReplayedMessages; };
+		// timing mode: aPasses runs of a capture through the parser on the calling thread, as fast
+		// as possible, the events applied as update() would. canvas frames are only handed to the
+		// decoder, see VDBenchmark for the rest. render thread, the network thread is paused meanwhile
+		VDReplayTiming				timeReplay(const fs::path &aPath, int aPasses = 10);
+		// text messages no handler matched
+		uint64_t					getUnhandledMessages() const { return mUnhandledMessages; };
 		// change a control value and update network clients
 		void						changeFloatValue(unsigned int aControl, float aValue, bool forceSend = false, bool toggle = false, bool increase = false, bool decrease = false);
 		void						changeIntValue(unsigned int aControl, int aValue);
@@ -46,21 +155,138 @@ namespace videodromm
 		void						changeShaderIndex(unsigned int aWarpIndex, unsigned int aWarpShaderIndex, unsigned int aSlot);
 		void						changeWarpFboIndex(unsigned int aWarpIndex, unsigned int aWarpFboIndex, unsigned int aSlot); //aSlot 0 = A, 1 = B,...
 		void                        changeFragmentShader(string aFragmentShaderText);
+		// uniforms from params and k2 messages, snapshot swapped once per update()
+		const VDUniformSnapshot &	getUniforms(unsigned int aSource = 0) const { return getSource(aSource).uniforms->getSnapshot(); };
+		// true when the snapshot changed this frame, dirty bits are only meaningful then
+		bool						hasUniformChanges(unsigned int aSource = 0) const { return getSource(aSource).uniformsChanged; };
+		// play params and k2 values of aSource out aSeconds behind their sender timestamp (osc bundles)
+		// or arrival time, interpolated every frame. 0 applies them on arrival. false while replaying
+		bool						setJitterDelay(double aSeconds, unsigned int aSource = 0);
+		VDJitterStats				getJitterStats(unsigned int aSource = 0) const;
+		// traffic by opcode, send queue and ping round trip of the connection of aSource.
+		// every connected source is pinged each kPingInterval seconds
+		WebSocketStats				getConnectionStats(unsigned int aSource = 0) const { return getSource(aSource).client->getStats(); };
 		// received shaders
 		bool						hasReceivedShader() { return shaderReceived; };
 		string						getReceivedShader();
 		bool						hasReceivedUniforms() { return shaderUniforms; };
 		string						getReceivedUniforms();
-		// received stream
-		string *					getBase64Image();
-		bool						hasReceivedStream() { return streamReceived; };
+		// the hydra uniforms, parsed once per message into a std140 block.
+		// upload getData() when getVersion() changed, see VDUniformBlock
+		const VDUniformBlock &		getHydraUniformBlock() const { return mHydraBlock; };
+		// repeated shaders and processed shader lru hits/misses
+		VDShaderCacheStats			getShaderCacheStats() const { return mShaderCache->getStats(); };
+		// frag and hydra edits of aSource received as patches instead of full text
+		VDShaderPatchStats			getShaderPatchStats(unsigned int aSource = 0) const { return getSource(aSource).shaderPatcher.getStats(); };
+		// received stream, decoded off the render thread
+		bool						acquireCanvasFrame(Surface8uRef &aSurface) { return acquireCanvasFrame(0, aSurface); };
+		bool						acquireCanvasFrame(unsigned int aSource, Surface8uRef &aSurface);
+		bool						hasReceivedStream(unsigned int aSource = 0) { return getSource(aSource).canvasDecoder->hasFrame(); };
+		// received, dropped and presented canvas frames, to tune the sender rate
+		VDCanvasStats				getCanvasStats(unsigned int aSource = 0) const { return getSource(aSource).canvasDecoder->getStats(); };
+		// latency from the socket read to parsed, to picked up by the render thread and to presented.
+		// call framePresented() once the frame has been sent out, e.g. after SpoutOut::sendViewport()
+		void						framePresented();
+		VDLatencySummary			getLatency(VDLatencyTracker::Type aType, VDLatencyTracker::Stage aStage) const { return mLatency->getSummary(aType, aStage); };
+		string						getLatencyReport() const { return mLatency->getReport(); };
+		// log the percentiles every aSeconds, 0 disables
+		void						setLatencyLogInterval(double aSeconds) { mLatency->setLogInterval(aSeconds); };
+		// GET /metrics (prometheus) and /stats (json) on aPort, answered on the network thread
+		// from the snapshot framePresented() publishes every kMetricsInterval seconds.
+		// the network thread is paused while the acceptor opens or closes
+		bool						startMetricsServer(uint16_t aPort);
+		void						stopMetricsServer();
+		bool						isMetricsServing() const { return mMetricsServer && mMetricsServer->getServer().is_listening(); };
+		// an app value reported as hydra_<aName>, e.g. setMetric("warp_mesh_rebuilds_total", Warp::getMeshRebuildCount()).
+		// render thread, picked up by the next snapshot
+		void						setMetric(const string &aName, double aValue) { mCustomMetrics[aName] = aValue; };
+		VDMetricsSnapshotRef		getMetricsSnapshot() const { return mMetrics.getSnapshot(); };
 	private:
+		// unknown ids fall back to the default source
+		const VDWebsocketSource &	getSource(unsigned int aSource) const { return *mSources[aSource < mSources.size() ? aSource : 0]; };
 		// lights4events
 		void						colorWrite();
 		// WebSockets
-		void						parseMessage(string msg);
-		// Web socket client
-		bool						clientConnected;
+		void						parseMessage(const VDStringRef &aMessage);
+		void						parseJson(const VDStringRef &aJson);
+		void						parseParams(VDJsonReader &aReader);
+		void						parseK2(VDJsonReader &aReader);
+		// the current source's table, or its jitter buffer
+		void						setVec4Uniform(unsigned int aIndex, const vec4 &aValue);
+		// parsing thread: a table fed through a jitter buffer is published by the render thread
+		void						publishUniforms(VDWebsocketSource &aSource);
+		void						parseEvent(const VDStringRef &aEvent, const VDStringRef &aMessage, int aVersion);
+		bool						parseCanvas(const VDStringRef &aMessage);
+		void						parseShaderHeader(const VDStringRef &aMessage);
+		VDProcessedShaderRef		processShaderHeader(const VDStringRef &aMessage);
+		void						deliverShader(VDShaderCache::Kind aKind, VDWebsocketEvent::Type aType, const VDStringRef &aContent, int aVersion);
+		// splices against the current source's last frag or hydra text, see VDShaderPatcher
+		void						parseShaderPatch(VDJsonReader &aReader);
+		void						requestShaderResend(VDShaderCache::Kind aKind);
+		// latency: the message being parsed, set by beginMessage() on the parsing thread
+		VDLatencyTrackerRef			mLatency;
+		uint64_t					mMessageReceived;
+		// sender time of the osc message being routed, 0 if unknown
+		uint64_t					mMessageSenderTime;
+		VDLatencyTracker::Type		mMessageType;
+		// keeps the payload of the message being parsed alive, null when it is not owned (replay, udp)
+		std::shared_ptr<void>		mMessageOwner;
+		void						beginMessage(VDWebsocketSource *aSource, uint64_t aReceived, const std::shared_ptr<void> &aOwner = nullptr);
+		void						endMessage();
+		// render thread: oldest change per type picked up since the last presented frame
+		uint64_t					mPresentPending[VDLatencyTracker::TYPE_COUNT];
+		void						applied(VDLatencyTracker::Type aType, uint64_t aReceived);
+		uint64_t					mShaderReceived;
+		uint64_t					mHydraReceived;
+		VDShaderCacheRef			mShaderCache;
+		// glsl/received and glsl/processed
+		VDShaderArchiveRef			mShaderArchive;
+		VDPrefixDispatcher			mDispatcher;
+		// json array of several messages
+		void						parseBatch(const VDStringRef &aMessage);
+		// outbound commands of the current frame
+		VDMessageBuilder			mOutbox;
+		void						addDefaultHandlers();
+		std::atomic<uint64_t>		mUnhandledMessages;
+		// binary canvas protocol, see VDCanvasHeader
+		void						parseBinary(const void *aData, size_t aSize);
+		// osc packets, in text or binary messages
+		void						parseOsc(const void *aData, size_t aSize);
+		VDOscRouter					mOscRouter;
+		void						addDefaultOscRoutes();
+		// reused for escaped json messages to avoid allocating per message
+		string						mUnescapeBuffer;
+		VDWebsocketEvent			mEvent;
+		void						deliverEvent(VDWebsocketEvent &aEvent);
+		void						applyEvent(VDWebsocketEvent &aEvent);
+		// network thread, runs the io_service shared by all sources
+		asio::io_service			mIoService;
+		std::unique_ptr<asio::io_service::work>	mIoWork;
+		std::thread					mNetworkThread;
+		std::atomic<bool>			mNetworkThreaded;
+		VDBoundedQueue<VDWebsocketEvent>	mInbox;
+		std::atomic<uint64_t>		mInboxDropped;
+		// capture
+		VDTrafficRecorderRef		mRecorder;
+		std::thread					mReplayThread;
+		std::atomic<bool>			mReplaying;
+		std::atomic<bool>			mReplayCancel;
+		std::atomic<uint64_t>		mReplayedMessages;
+		bool						mResumeNetworkThread;
+		void						joinReplay();
+		// one captured message through the parser, on the replay thread or in timeReplay()
+		void						replayMessage(uint8_t aOpcode, uint8_t aSource, const void *aData, size_t aSize);
+		// Web socket clients, destroyed before mIoService
+		vector<VDWebsocketSourceRef>	mSources;
+		// destroyed before mIoService, once the network thread is stopped
+		std::unique_ptr<WebSocketServer>	mMetricsServer;
+		VDOscReceiverRef			mOscReceiver;
+		// the source of the message being parsed, set by its handlers
+		VDWebsocketSource *			mCurrentSource;
+		void						connectSource(VDWebsocketSource &aSource);
+		// pings and writes asked for by the render thread run on the io_service, where the
+		// connections live: on the network thread, or in the next update() poll
+		void						post(const std::function<void()> &aTask);
 		void						wsClientConnect();
 		void						wsClientDisconnect();
 		int							receivedType;
@@ -69,18 +295,22 @@ namespace videodromm
 		int							receivedShaderIndex;
 		int							receivedSlot;
 
-		WebSocketClient				mClient;
+		// last wsPing(), see update()
 		double						mPingTime;
+		static const double			kPingInterval;
 
 		// received shaders
 		bool						shaderReceived; // TODO remove
 		string						receivedFragString; // TODO remove
 		bool						shaderUniforms;
 		string						receivedUniformsString;
-
-		string						mBase64String;
-		// received stream
-		bool						streamReceived;
+		VDUniformBlock				mHydraBlock;
+		// metrics, served by mMetricsServer
+		static const double			kMetricsInterval;
+		VDMetrics					mMetrics;
+		double						mMetricsTime;
+		std::map<string, double>	mCustomMetrics;
+		void						publishMetrics();
 	};
 }
 
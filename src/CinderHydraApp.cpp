@@ -30,6 +30,7 @@
 #include "CiSpoutOut.h"
 // Websocket
 #include "VDWebsocket.h"
+#include "VDBenchmark.h"
 
 using namespace ci;
 using namespace ci::app;
@@ -57,6 +58,8 @@ public:
 	void keyUp( KeyEvent event ) override;
 
 	void updateWindowTitle();
+	// --bench [capture]
+	void runBenchmark( const fs::path &capture );
 	SpoutOut mSpoutOut;
 private:
 	// VDWebsocket
@@ -83,7 +86,18 @@ void CinderHydraApp::setup()
 	disableFrameRate();
 	// Websocket
 	mVDWebsocket = VDWebsocket::create();
-	mVDWebsocket->wsConnect();
+	// CinderHydra --bench [capture]: print the timings of the message paths and quit
+	const vector<string> &args = getCommandLineArgs();
+	auto bench = find( args.begin(), args.end(), "--bench" );
+	if( bench != args.end() ) {
+		runBenchmark( bench + 1 != args.end() ? fs::path( *( bench + 1 ) ) : fs::path() );
+		quit();
+		return;
+	}
+	// http://<host>:8089/metrics and /stats, next to the router on 8088
+	mVDWebsocket->startMetricsServer( 8089 );
+	// keep socket reads and parsing out of the frame budget
+	mVDWebsocket->startNetworkThread();
 	// initialize warps
 	mSettings = getAssetPath( "" ) / "warps.xml";
 	if( fs::exists( mSettings ) ) {
@@ -114,13 +128,26 @@ void CinderHydraApp::setup()
 
 void CinderHydraApp::cleanup()
 {
-	// save warp settings
-	Warp::writeSettings( mWarps, writeFile( mSettings ) );
+	// save warp settings, none were loaded in --bench mode
+	if( !mSettings.empty() )
+		Warp::writeSettings( mWarps, writeFile( mSettings ) );
 }
 
 void CinderHydraApp::update()
 {
 	mVDWebsocket->update();
+	// pick up the latest decoded hydra canvas, decoding happens on worker threads
+	Surface8uRef canvas;
+	if( mVDWebsocket->acquireCanvasFrame( canvas ) ) {
+		if( mImage && mImage->getSize() == canvas->getSize() ) {
+			mImage->update( *canvas );
+		}
+		else {
+			mImage = gl::Texture::create( *canvas, gl::Texture2d::Format().loadTopDown() );
+			mSrcArea = mImage->getBounds();
+			Warp::setSize( mWarps, mImage->getSize() );
+		}
+	}
 }
 
 void CinderHydraApp::draw()
@@ -137,6 +164,12 @@ void CinderHydraApp::draw()
 		}
 	}
 	mSpoutOut.sendViewport();
+	mVDWebsocket->setMetric( "warp_mesh_rebuilds_total", (double)Warp::getMeshRebuildCount() );
+	mVDWebsocket->setMetric( "warp_mesh_updates_total", (double)Warp::getMeshUpdateCount() );
+	// the changes picked up in update() are out now
+	mVDWebsocket->framePresented();
+	// commands issued during this frame leave as one websocket message
+	mVDWebsocket->flush();
 }
 
 void CinderHydraApp::resize()
@@ -224,6 +257,18 @@ void CinderHydraApp::keyUp( KeyEvent event )
 	}
 }
 
+void CinderHydraApp::runBenchmark( const fs::path &capture )
+{
+	string report;
+	if( !capture.empty() )
+		report += VDBenchmark::parse( *mVDWebsocket, capture );
+	report += VDBenchmark::base64();
+	// one io thread against as many as there are cores
+	report += VDBenchmark::serverLoad( 1 );
+	report += VDBenchmark::serverLoad( max( 2u, std::thread::hardware_concurrency() ) );
+	console() << report << std::endl;
+}
+
 void CinderHydraApp::updateWindowTitle()
 {
 	getWindow()->setTitle( "Warping Sample - Using draw()" );
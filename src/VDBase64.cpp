@@ -0,0 +1,212 @@
+#include "VDBase64.h"
+
+#if defined( _M_X64 ) || defined( __x86_64__ ) || defined( _M_IX86 ) || defined( __i386__ )
+	#define VD_BASE64_X86
+	#include <immintrin.h>
+	#if defined( _MSC_VER )
+		#include <intrin.h>
+		// msvc compiles any intrinsic without per-function target flags
+		#define VD_TARGET_SSE41
+		#define VD_TARGET_AVX2
+	#else
+		#include <cpuid.h>
+		#define VD_TARGET_SSE41 __attribute__((target("ssse3,sse4.1")))
+		#define VD_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+using namespace videodromm;
+
+namespace {
+	enum Implementation { SCALAR, SSE41, AVX2 };
+
+	struct DecodeTable {
+		uint8_t values[256];
+		DecodeTable() {
+			const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+			for (int i = 0; i < 256; i++) values[i] = 0x80;
+			for (int i = 0; i < 64; i++) values[(uint8_t)alphabet[i]] = (uint8_t)i;
+		}
+	};
+	const DecodeTable sTable;
+
+	// handles the tail and padding, and whatever the vector loops refused
+	bool decodeScalar(const char *aSrc, size_t aSrcSize, uint8_t *aDst, size_t &aDstSize) {
+		const uint8_t *src = (const uint8_t *)aSrc;
+		size_t n = aSrcSize;
+		int padding = 0;
+		while (n > 0 && src[n - 1] == '=' && padding < 2) {
+			n--;
+			padding++;
+		}
+		const uint8_t *table = sTable.values;
+		uint8_t *dst = aDst;
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			uint8_t a = table[src[i]], b = table[src[i + 1]], c = table[src[i + 2]], d = table[src[i + 3]];
+			if ((a | b | c | d) & 0x80) return false;
+			*dst++ = (uint8_t)((a << 2) | (b >> 4));
+			*dst++ = (uint8_t)((b << 4) | (c >> 2));
+			*dst++ = (uint8_t)((c << 6) | d);
+		}
+		size_t remaining = n - i;
+		if (remaining == 1) return false;
+		if (remaining >= 2) {
+			uint8_t a = table[src[i]], b = table[src[i + 1]];
+			if ((a | b) & 0x80) return false;
+			*dst++ = (uint8_t)((a << 2) | (b >> 4));
+			if (remaining == 3) {
+				uint8_t c = table[src[i + 2]];
+				if (c & 0x80) return false;
+				*dst++ = (uint8_t)((b << 4) | (c >> 2));
+			}
+		}
+		aDstSize = dst - aDst;
+		return true;
+	}
+
+#if defined( VD_BASE64_X86 )
+	// vector decoding after Wojciech Mula and Daniel Lemire, "Faster Base64 Encoding and Decoding
+	// using AVX2 Instructions": nibble lookups validate and translate 16 or 32 characters at once,
+	// multiply-adds pack the 6 bit values and a shuffle gathers the output bytes.
+	// the loops stop at the first block holding padding or an invalid character.
+
+	VD_TARGET_SSE41 void decodeSse41(const char *&aSrc, size_t &aSrcSize, uint8_t *&aDst) {
+		const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+		const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+		const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+		const __m128i mask2F = _mm_set1_epi8(0x2F);
+		const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+		// 16 bytes are stored for 12 decoded, keep enough input so the store stays inside the output
+		while (aSrcSize >= 24) {
+			__m128i str = _mm_loadu_si128((const __m128i *)aSrc);
+			__m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask2F);
+			__m128i loNibbles = _mm_and_si128(str, mask2F);
+			__m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+			__m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+			if (!_mm_testz_si128(lo, hi)) break;
+			__m128i eq2F = _mm_cmpeq_epi8(str, mask2F);
+			__m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2F, hiNibbles));
+			str = _mm_add_epi8(str, roll);
+			__m128i merged = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+			merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+			merged = _mm_shuffle_epi8(merged, pack);
+			_mm_storeu_si128((__m128i *)aDst, merged);
+			aSrc += 16;
+			aSrcSize -= 16;
+			aDst += 12;
+		}
+	}
+
+	VD_TARGET_AVX2 void decodeAvx2(const char *&aSrc, size_t &aSrcSize, uint8_t *&aDst) {
+		const __m256i lutLo = _mm256_setr_epi8(
+			0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+			0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+		const __m256i lutHi = _mm256_setr_epi8(
+			0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+			0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+		const __m256i lutRoll = _mm256_setr_epi8(
+			0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+			0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+		const __m256i mask2F = _mm256_set1_epi8(0x2F);
+		const __m256i pack = _mm256_setr_epi8(
+			2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+			2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+		const __m256i gather = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1);
+		// 32 bytes are stored for 24 decoded
+		while (aSrcSize >= 48) {
+			__m256i str = _mm256_loadu_si256((const __m256i *)aSrc);
+			__m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask2F);
+			__m256i loNibbles = _mm256_and_si256(str, mask2F);
+			__m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+			__m256i lo = _mm256_shuffle_epi8(lutLo, loNibbles);
+			if (!_mm256_testz_si256(lo, hi)) break;
+			__m256i eq2F = _mm256_cmpeq_epi8(str, mask2F);
+			__m256i roll = _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(eq2F, hiNibbles));
+			str = _mm256_add_epi8(str, roll);
+			__m256i merged = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+			merged = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+			merged = _mm256_shuffle_epi8(merged, pack);
+			merged = _mm256_permutevar8x32_epi32(merged, gather);
+			_mm256_storeu_si256((__m256i *)aDst, merged);
+			aSrc += 32;
+			aSrcSize -= 32;
+			aDst += 24;
+		}
+	}
+
+	void cpuid(int aInfo[4], int aLeaf) {
+	#if defined( _MSC_VER )
+		__cpuidex(aInfo, aLeaf, 0);
+	#else
+		__cpuid_count(aLeaf, 0, aInfo[0], aInfo[1], aInfo[2], aInfo[3]);
+	#endif
+	}
+
+	uint64_t xgetbv() {
+	#if defined( _MSC_VER )
+		return _xgetbv(0);
+	#else
+		uint32_t eax, edx;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return ((uint64_t)edx << 32) | eax;
+	#endif
+	}
+
+	Implementation detect() {
+		int info[4];
+		cpuid(info, 0);
+		int maxLeaf = info[0];
+		if (maxLeaf < 1) return SCALAR;
+		cpuid(info, 1);
+		bool ssse3 = (info[2] & (1 << 9)) != 0;
+		bool sse41 = (info[2] & (1 << 19)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		if (maxLeaf >= 7 && osxsave && avx && (xgetbv() & 6) == 6) {
+			cpuid(info, 7);
+			if (info[1] & (1 << 5)) return AVX2;
+		}
+		return ssse3 && sse41 ? SSE41 : SCALAR;
+	}
+#else
+	Implementation detect() {
+		return SCALAR;
+	}
+#endif
+
+	Implementation getImplementation() {
+		static const Implementation implementation = detect();
+		return implementation;
+	}
+}
+
+bool VDBase64::decode(const char *aSrc, size_t aSrcSize, uint8_t *aDst, size_t &aDstSize) {
+	uint8_t *dst = aDst;
+#if defined( VD_BASE64_X86 )
+	switch (getImplementation()) {
+	case AVX2:
+		decodeAvx2(aSrc, aSrcSize, dst);
+		// the 128 bit loop picks up what is left before the scalar tail
+		decodeSse41(aSrc, aSrcSize, dst);
+		break;
+	case SSE41:
+		decodeSse41(aSrc, aSrcSize, dst);
+		break;
+	default:
+		break;
+	}
+#endif
+	size_t tail = 0;
+	if (!decodeScalar(aSrc, aSrcSize, dst, tail)) return false;
+	aDstSize = (dst - aDst) + tail;
+	return true;
+}
+
+const char * VDBase64::getImplementationName() {
+	switch (getImplementation()) {
+	case AVX2: return "avx2";
+	case SSE41: return "sse4.1";
+	default: return "scalar";
+	}
+}
@@ -0,0 +1,241 @@
+#include "VDBenchmark.h"
+
+#include "cinder/Json.h"
+#include "cinder/Utilities.h"
+
+#include "VDBase64.h"
+#include "VDPrefixDispatcher.h"
+#include "WebSocketClient.h"
+#include "WebSocketServer.h"
+#include "websocketpp/base64/base64.hpp"
+
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <thread>
+
+using namespace ci;
+using namespace std;
+using namespace videodromm;
+
+namespace {
+	// keeps the results of the baselines from being optimized away
+	volatile float sSink;
+
+	uint64_t elapsedNanos(std::chrono::steady_clock::time_point aStart) {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - aStart).count();
+	}
+
+	// "name: 1200 messages, 3.5 MB, 850 ns/message, 4100 MB/s"
+	void report(stringstream &ss, const string &aName, uint64_t aMessages, uint64_t aBytes, uint64_t aNanos) {
+		ss << aName << ": " << aMessages << " messages, " << aBytes / 1048576.0 << " MB";
+		if (aMessages > 0 && aNanos > 0) {
+			ss << ", " << aNanos / aMessages << " ns/message, " << (aBytes / 1048576.0) / (aNanos / 1e9) << " MB/s";
+		}
+		ss << "\n";
+	}
+
+	// parseMessage before VDJsonReader: a DOM per message, children and strings copied
+	void parseJsonTree(const string &aMessage) {
+		float sink = 0.0f;
+		try {
+			JsonTree json(aMessage);
+			if (json.hasChild("params")) {
+				JsonTree params = json.getChild("params");
+				for (JsonTree::ConstIter it = params.begin(); it != params.end(); ++it) {
+					sink += it->getChild("name").getValue<int>() + it->getChild("value").getValue<float>();
+				}
+			}
+			if (json.hasChild("k2")) {
+				JsonTree k2 = json.getChild("k2");
+				for (JsonTree::ConstIter it = k2.begin(); it != k2.end(); ++it) {
+					vector<string> values = split(it->getChild("value").getValue(), ",");
+					for (const string &value : values) sink += strtof(value.c_str(), 0);
+				}
+			}
+			if (json.hasChild("event") && json.hasChild("message")) {
+				string event = json.getChild("event").getValue();
+				// canvas, hydra and frag copied their message
+				string message = json.getChild("message").getValue<string>();
+				sink += (float)(event.size() + message.size());
+			}
+		}
+		catch (JsonTree::Exception &) {
+		}
+		sSink = sink;
+	}
+
+	// the branches of parseMessage before VDPrefixDispatcher, one temporary per substr
+	int classifySubstr(const string &aMessage) {
+		if (aMessage.empty()) return 0;
+		string first = aMessage.substr(0, 1);
+		if (first == "{") return 1;
+		if (aMessage.substr(0, 2) == "/*") return 2;
+		if (aMessage.substr(0, 8) == "#version") return 3;
+		if (first == "/") return 4;
+		if (first == "I") {
+			if (aMessage == "ImInit") return 5;
+			if (aMessage.substr(0, 11) == "ImMouseMove") return 6;
+			if (aMessage.substr(0, 12) == "ImMousePress") return 7;
+		}
+		return 0;
+	}
+}
+
+string VDBenchmark::parse(VDWebsocket &aWebsocket, const fs::path &aPath, int aPasses) {
+	stringstream ss;
+	VDTrafficReplayerRef replayer = VDTrafficReplayer::create(aPath);
+	if (!replayer->isOpen()) return "parse: cannot open " + aPath.string() + "\n";
+	ss << "parse " << aPath.filename().string() << ", " << replayer->getMessageCount() << " messages x " << aPasses << "\n";
+	VDReplayTiming timing = aWebsocket.timeReplay(aPath, aPasses);
+	report(ss, "  VDJsonReader json", timing.messages[VDReplayTiming::JSON], timing.bytes[VDReplayTiming::JSON], timing.nanos[VDReplayTiming::JSON]);
+	report(ss, "  VDWebsocket other text", timing.messages[VDReplayTiming::TEXT], timing.bytes[VDReplayTiming::TEXT], timing.nanos[VDReplayTiming::TEXT]);
+	report(ss, "  VDWebsocket binary", timing.messages[VDReplayTiming::BINARY], timing.bytes[VDReplayTiming::BINARY], timing.nanos[VDReplayTiming::BINARY]);
+
+	// the same json messages through JsonTree, copied into a string as onMessage used to
+	uint64_t messages = 0, bytes = 0, nanos = 0;
+	atomic<bool> cancel(false);
+	for (int pass = 0; pass < aPasses; pass++) {
+		replayer->replay(0.0f, [&](uint8_t aOpcode, uint8_t aSource, const void *aData, size_t aSize) {
+			if (aOpcode != VDTrafficCapture::TEXT || aSize == 0 || *(const char *)aData != '{') return;
+			auto start = std::chrono::steady_clock::now();
+			parseJsonTree(string((const char *)aData, aSize));
+			nanos += elapsedNanos(start);
+			messages++;
+			bytes += aSize;
+		}, cancel);
+	}
+	report(ss, "  JsonTree json", messages, bytes, nanos);
+
+	// classification only: the prefixes of addDefaultHandlers(), handlers that do nothing
+	VDPrefixDispatcher dispatcher;
+	int matched = 0;
+	const char *prefixes[] = { "{", "[", "/*", "#version", "/", "#bundle", "ImInit", "ImMouseMove", "ImMousePress" };
+	for (const char *prefix : prefixes) dispatcher.addHandler(prefix, [&matched](const VDStringRef &aMessage) { matched++; });
+	// timed over all messages at once, a clock read costs about as much as one classification.
+	// the views point into the mapped capture, the copies are the strings onMessage used to pass
+	vector<VDStringRef> views;
+	vector<string> copies;
+	bytes = 0;
+	replayer->replay(0.0f, [&](uint8_t aOpcode, uint8_t aSource, const void *aData, size_t aSize) {
+		if (aOpcode != VDTrafficCapture::TEXT) return;
+		views.push_back(VDStringRef((const char *)aData, aSize));
+		copies.push_back(views.back().str());
+		bytes += aSize;
+	}, cancel);
+	auto start = std::chrono::steady_clock::now();
+	for (int pass = 0; pass < aPasses; pass++) {
+		for (const VDStringRef &view : views) dispatcher.dispatch(view);
+	}
+	nanos = elapsedNanos(start);
+	report(ss, "  VDPrefixDispatcher classify", views.size() * aPasses, bytes * aPasses, nanos);
+	start = std::chrono::steady_clock::now();
+	for (int pass = 0; pass < aPasses; pass++) {
+		for (const string &copy : copies) matched += classifySubstr(copy);
+	}
+	nanos = elapsedNanos(start);
+	report(ss, "  substr classify", copies.size() * aPasses, bytes * aPasses, nanos);
+	sSink = (float)matched;
+	return ss.str();
+}
+
+string VDBenchmark::base64(int aPasses) {
+	stringstream ss;
+	ss << "base64, " << aPasses << " passes, VDBase64 uses " << VDBase64::getImplementationName() << "\n";
+	mt19937 random(1);
+	for (size_t megabytes = 1; megabytes <= 8; megabytes *= 2) {
+		// a canvas frame is base64 of jpeg bytes, random bytes are as incompressible
+		string raw(megabytes * 1048576 * 3 / 4, '\0');
+		for (char &c : raw) c = (char)(random() & 0xff);
+		string encoded = websocketpp::base64_encode(raw);
+		// decoded into one buffer, as the canvas workers do
+		vector<uint8_t> decoded(VDBase64::decodedCapacity(encoded.size()));
+		size_t decodedSize = 0;
+		bool same = true;
+		uint64_t nanos = 0;
+		for (int pass = 0; pass < aPasses; pass++) {
+			auto start = std::chrono::steady_clock::now();
+			same = VDBase64::decode(encoded.data(), encoded.size(), decoded.data(), decodedSize) && same;
+			nanos += elapsedNanos(start);
+		}
+		same = same && decodedSize == raw.size() && memcmp(decoded.data(), raw.data(), raw.size()) == 0;
+		report(ss, "  VDBase64 " + to_string(megabytes) + " MB" + (same ? "" : " (wrong output)"), aPasses, encoded.size() * aPasses, nanos);
+		nanos = 0;
+		for (int pass = 0; pass < aPasses; pass++) {
+			auto start = std::chrono::steady_clock::now();
+			string result = websocketpp::base64_decode(encoded);
+			nanos += elapsedNanos(start);
+			sSink = (float)result.size();
+		}
+		report(ss, "  websocketpp " + to_string(megabytes) + " MB", aPasses, encoded.size() * aPasses, nanos);
+	}
+	return ss.str();
+}
+
+string VDBenchmark::serverLoad(size_t aThreads, size_t aClients, size_t aMessages) {
+	stringstream ss;
+	ss << "server load, " << aThreads << " threads, " << aClients << " clients x " << aMessages << " messages\n";
+	atomic<size_t> opened(0), received(0), misrouted(0);
+	atomic<uint64_t> bytes(0);
+	asio::io_service serverIo;
+	WebSocketServer server(&serverIo);
+	// answered on the connection the message came from, see WebSocketConnection::getHandle()
+	server.connectMessageEventHandler([&server](string aMessage) { server.write(aMessage); });
+	server.connectOpenEventHandler([&opened]() { opened++; });
+	server.getServer().set_reuse_addr(true);
+	server.listen(0);
+	asio::error_code err;
+	uint16_t port = server.getServer().get_local_endpoint(err).port();
+	if (err) return "server load: cannot listen\n";
+	thread serverThread([&server, aThreads]() { server.run(aThreads); });
+
+	// the clients share one io_service on their own thread, as the sources of VDWebsocket do
+	asio::io_service clientIo;
+	asio::io_service::work work(clientIo);
+	vector<string> tags;
+	vector<unique_ptr<WebSocketClient>> clients;
+	for (size_t i = 0; i < aClients; i++) {
+		tags.push_back("client " + to_string(i));
+		clients.emplace_back(new WebSocketClient(&clientIo));
+		const string &tag = tags.back();
+		clients.back()->connectMessageEventHandler([&, tag](string aMessage) {
+			if (aMessage != tag) misrouted++;
+			bytes += aMessage.size();
+			received++;
+		});
+		clients.back()->connect("ws://localhost:" + to_string(port));
+	}
+	thread clientThread([&clientIo]() { clientIo.run(); });
+	auto start = std::chrono::steady_clock::now();
+	while (opened < aClients && std::chrono::steady_clock::now() - start < std::chrono::seconds(10)) {
+		this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	if (opened < aClients) {
+		ss << "  " << opened << " of " << aClients << " clients connected\n";
+	}
+	else {
+		// all messages queued at once, on the client thread since writes are not thread safe
+		size_t expected = aClients * aMessages;
+		start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < aClients; i++) {
+			WebSocketClient *client = clients[i].get();
+			const string &tag = tags[i];
+			clientIo.post([client, &tag, aMessages]() {
+				for (size_t k = 0; k < aMessages; k++) client->write(tag);
+			});
+		}
+		while (received < expected && std::chrono::steady_clock::now() - start < std::chrono::seconds(30)) {
+			this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+		uint64_t nanos = elapsedNanos(start);
+		report(ss, "  echoes", received, bytes, nanos);
+		if (nanos > 0) ss << "  " << (uint64_t)(received / (nanos / 1e9)) << " messages/s\n";
+		ss << "  misrouted " << misrouted << ", missing " << expected - received << ", dropped by the server " << server.getNumDroppedMessages() << "\n";
+	}
+	// the handlers refer to this frame, both loops are done before anything goes out of scope
+	clientIo.stop();
+	clientThread.join();
+	serverIo.stop();
+	serverThread.join();
+	return ss.str();
+}
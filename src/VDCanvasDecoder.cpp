@@ -0,0 +1,247 @@
+#include "VDCanvasDecoder.h"
+
+#include "cinder/Buffer.h"
+#include "cinder/ImageIo.h"
+#include "cinder/Log.h"
+
+#include "VDBase64.h"
+#include "VDLatency.h"
+
+#include <chrono>
+
+using namespace ci;
+using namespace std;
+using namespace videodromm;
+
+namespace {
+	uint32_t readUint32(const uint8_t *p) {
+		return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+	}
+}
+
+bool VDCanvasHeader::parse(const uint8_t *aData, size_t aSize, VDCanvasHeader &aHeader) {
+	if (aSize < kSize || memcmp(aData, "HYDC", 4) != 0) return false;
+	aHeader.version = aData[4];
+	aHeader.format = aData[5];
+	aHeader.width = readUint32(aData + 8);
+	aHeader.height = readUint32(aData + 12);
+	aHeader.sequence = readUint32(aData + 16);
+	aHeader.timestamp = (uint64_t)readUint32(aData + 20) | ((uint64_t)readUint32(aData + 24) << 32);
+	return aHeader.version == kVersion && (aHeader.format == JPEG || aHeader.format == RGBA);
+}
+
+VDCanvasDecoder::VDCanvasDecoder(unsigned int aNumWorkers)
+	: mRunning(true), mNextSequence(0), mReady(nullptr), mPublishedSequence(0),
+	mReceived(0), mDropped(0), mFailed(0), mPresented(0),
+	mJsonFrames(0), mJsonBytes(0), mJsonDecodeMicros(0),
+	mBinaryFrames(0), mBinaryBytes(0), mBinaryDecodeMicros(0) {
+	mPending.sequence = 0;
+	mSpare.sequence = 0;
+	if (aNumWorkers == 0) aNumWorkers = 1;
+	for (unsigned int i = 0; i < aNumWorkers; i++) {
+		mWorkers.push_back(thread(&VDCanvasDecoder::workerLoop, this));
+	}
+}
+
+VDCanvasDecoder::~VDCanvasDecoder() {
+	{
+		lock_guard<mutex> lock(mJobMutex);
+		mRunning = false;
+	}
+	mJobCondition.notify_all();
+	for (auto &worker : mWorkers) {
+		if (worker.joinable()) worker.join();
+	}
+	delete mReady.exchange(nullptr);
+}
+
+void VDCanvasDecoder::submitBase64(const char *aData, size_t aSize, uint64_t aReceived, const shared_ptr<void> &aOwner) {
+	// canvas.toDataURL() prefixes the payload with data:image/jpeg;base64,
+	if (aSize > 5 && memcmp(aData, "data:", 5) == 0) {
+		const char *comma = (const char *)memchr(aData, ',', aSize);
+		if (!comma) return;
+		aSize -= (comma + 1) - aData;
+		aData = comma + 1;
+	}
+	if (aSize == 0) return;
+	mJsonFrames++;
+	mJsonBytes += aSize;
+	submit(aData, aSize, FORMAT_BASE64, nullptr, aReceived, aOwner);
+}
+
+void VDCanvasDecoder::submitBinary(const VDCanvasHeader &aHeader, const uint8_t *aData, size_t aSize, uint64_t aReceived, const shared_ptr<void> &aOwner) {
+	if (aSize == 0) return;
+	mBinaryFrames++;
+	mBinaryBytes += aSize + VDCanvasHeader::kSize;
+	// the size comes from the peer: bounded before multiplying, and before Surface8u takes it as int
+	if (aHeader.width > VDCanvasHeader::kMaxDimension || aHeader.height > VDCanvasHeader::kMaxDimension) {
+		mFailed++;
+		return;
+	}
+	if (aHeader.format == VDCanvasHeader::RGBA && (aHeader.width == 0 || aHeader.height == 0 || (size_t)aHeader.width * aHeader.height * 4 != aSize)) {
+		mFailed++;
+		return;
+	}
+	submit((const char *)aData, aSize, aHeader.format == VDCanvasHeader::RGBA ? FORMAT_RGBA : FORMAT_JPEG, &aHeader, aReceived, aOwner);
+}
+
+void VDCanvasDecoder::submit(const char *aData, size_t aSize, Format aFormat, const VDCanvasHeader *aHeader, uint64_t aReceived, const shared_ptr<void> &aOwner) {
+	mReceived++;
+	// outside the lock, only the producer touches mSpare.
+	// an owned payload is referenced, otherwise copied
+	mSpare.owner = aOwner;
+	mSpare.payload = aData;
+	mSpare.size = aSize;
+	if (!aOwner) mSpare.data.assign(aData, aSize);
+	mSpare.format = aFormat;
+	mSpare.width = aHeader ? aHeader->width : 0;
+	mSpare.height = aHeader ? aHeader->height : 0;
+	mSpare.senderSequence = aHeader ? aHeader->sequence : 0;
+	mSpare.senderTimestamp = aHeader ? aHeader->timestamp : 0;
+	mSpare.received = aReceived;
+	{
+		lock_guard<mutex> lock(mJobMutex);
+		if (mPending.sequence != 0) {
+			// no worker picked up the previous frame, it is superseded
+			mDropped++;
+		}
+		mSpare.sequence = ++mNextSequence;
+		swap(mPending, mSpare);
+	}
+	// the superseded message can go now
+	mSpare.owner.reset();
+	mJobCondition.notify_one();
+}
+
+void VDCanvasDecoder::workerLoop() {
+	Job job;
+	job.sequence = 0;
+	// decoded jpeg bytes, reused across frames
+	vector<uint8_t> scratch;
+	while (true) {
+		{
+			unique_lock<mutex> lock(mJobMutex);
+			mJobCondition.wait(lock, [this] { return !mRunning || mPending.sequence != 0; });
+			if (!mRunning) return;
+			swap(job, mPending);
+			mPending.sequence = 0;
+		}
+		decode(job, scratch);
+		job.owner.reset();
+	}
+}
+
+Surface8uRef VDCanvasDecoder::decodeJpeg(const void *aData, size_t aSize) {
+	BufferRef buffer = Buffer::create((void *)aData, aSize);
+	ImageSourceRef image = loadImage(DataSourceBuffer::create(buffer), ImageSource::Options(), "jpg");
+	return Surface8uRef(new Surface8u(image, SurfaceConstraintsDefault(), true));
+}
+
+void VDCanvasDecoder::decode(const Job &aJob, vector<uint8_t> &aScratch) {
+	auto start = chrono::steady_clock::now();
+	// a copy is looked up here, swapping jobs can move short strings
+	const char *payload = aJob.owner ? aJob.payload : aJob.data.data();
+	size_t payloadSize = aJob.owner ? aJob.size : aJob.data.size();
+	Surface8uRef surface;
+	try {
+		switch (aJob.format) {
+		case FORMAT_BASE64: {
+			size_t capacity = VDBase64::decodedCapacity(payloadSize);
+			if (aScratch.size() < capacity) aScratch.resize(capacity);
+			size_t size = 0;
+			if (VDBase64::decode(payload, payloadSize, aScratch.data(), size) && size > 0) {
+				surface = decodeJpeg(aScratch.data(), size);
+			}
+			break;
+		}
+		case FORMAT_JPEG:
+			surface = decodeJpeg(payload, payloadSize);
+			break;
+		case FORMAT_RGBA: {
+			surface = Surface8uRef(new Surface8u(aJob.width, aJob.height, true, SurfaceChannelOrder::RGBA));
+			const uint8_t *src = (const uint8_t *)payload;
+			size_t srcRowBytes = (size_t)aJob.width * 4;
+			for (uint32_t y = 0; y < aJob.height; y++) {
+				memcpy(surface->getData() + y * surface->getRowBytes(), src + y * srcRowBytes, srcRowBytes);
+			}
+			break;
+		}
+		}
+	}
+	catch (const std::exception &e) {
+		CI_LOG_W("VDCanvasDecoder decode failed: " << e.what());
+		surface.reset();
+	}
+	uint64_t micros = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+	if (aJob.format == FORMAT_BASE64) mJsonDecodeMicros += micros;
+	else mBinaryDecodeMicros += micros;
+	if (!surface) {
+		mFailed++;
+		return;
+	}
+	VDCanvasFrame *frame = new VDCanvasFrame();
+	frame->surface = surface;
+	frame->sequence = aJob.sequence;
+	frame->senderSequence = aJob.senderSequence;
+	frame->senderTimestamp = aJob.senderTimestamp;
+	frame->received = aJob.received;
+	frame->decoded = VDLatencyTracker::now();
+	publish(frame);
+}
+
+void VDCanvasDecoder::publish(VDCanvasFrame *aFrame) {
+	// workers can finish out of order, never replace a newer frame with an older one
+	uint64_t published = mPublishedSequence.load(memory_order_relaxed);
+	do {
+		if (aFrame->sequence <= published) {
+			mDropped++;
+			delete aFrame;
+			return;
+		}
+	} while (!mPublishedSequence.compare_exchange_weak(published, aFrame->sequence, memory_order_relaxed));
+	// a frame the render thread has not picked up yet is superseded,
+	// unless a faster worker slipped a newer one in between, then put that one back
+	VDCanvasFrame *frame = aFrame;
+	while (frame) {
+		VDCanvasFrame *previous = mReady.exchange(frame, memory_order_acq_rel);
+		if (previous && previous->sequence > frame->sequence) {
+			frame = previous;
+		}
+		else {
+			if (previous) mDropped++;
+			delete previous;
+			frame = nullptr;
+		}
+	}
+}
+
+bool VDCanvasDecoder::acquireFrame(Surface8uRef &aSurface) {
+	VDCanvasFrame frame;
+	if (!acquireFrame(frame)) return false;
+	aSurface = frame.surface;
+	return true;
+}
+
+bool VDCanvasDecoder::acquireFrame(VDCanvasFrame &aFrame) {
+	VDCanvasFrame *frame = mReady.exchange(nullptr, memory_order_acq_rel);
+	if (!frame) return false;
+	aFrame = *frame;
+	delete frame;
+	mPresented++;
+	return true;
+}
+
+VDCanvasStats VDCanvasDecoder::getStats() const {
+	VDCanvasStats stats;
+	stats.received = mReceived.load();
+	stats.dropped = mDropped.load();
+	stats.failed = mFailed.load();
+	stats.presented = mPresented.load();
+	stats.jsonFrames = mJsonFrames.load();
+	stats.jsonBytes = mJsonBytes.load();
+	stats.jsonDecodeSeconds = mJsonDecodeMicros.load() / 1000000.0;
+	stats.binaryFrames = mBinaryFrames.load();
+	stats.binaryBytes = mBinaryBytes.load();
+	stats.binaryDecodeSeconds = mBinaryDecodeMicros.load() / 1000000.0;
+	return stats;
+}
@@ -0,0 +1,157 @@
+#include "VDConnectionManager.h"
+
+#include "cinder/Log.h"
+
+using namespace ci;
+using namespace std;
+using namespace videodromm;
+
+VDConnectionManager::VDConnectionManager(WebSocketClient &aClient)
+	: mClient(aClient), mTimer(aClient.getClient().get_io_service()), mResolver(aClient.getClient().get_io_service()),
+	mState(IDLE), mEndpointIndex(0), mFailures(0), mAttempts(0), mRandom(random_device()()) {
+	mEndpoints.push_back("ws://127.0.0.1:8088");
+}
+
+VDConnectionManager::~VDConnectionManager() {
+	asio::error_code err;
+	mTimer.cancel(err);
+	mResolver.cancel();
+}
+
+const char * VDConnectionManager::getStateName(State aState) {
+	switch (aState) {
+	case RESOLVING: return "resolving";
+	case CONNECTING: return "connecting";
+	case OPEN: return "open";
+	case BACKOFF: return "backoff";
+	default: return "idle";
+	}
+}
+
+void VDConnectionManager::setEndpoints(const vector<string> &aEndpoints) {
+	if (aEndpoints.empty()) return;
+	lock_guard<mutex> lock(mEndpointMutex);
+	mEndpoints = aEndpoints;
+	mEndpointIndex = 0;
+}
+
+string VDConnectionManager::getEndpoint() const {
+	lock_guard<mutex> lock(mEndpointMutex);
+	return mEndpoint;
+}
+
+void VDConnectionManager::post(function<void(VDConnectionManager &)> aStep) {
+	// handlers may outlive the manager, they only run while it exists
+	weak_ptr<VDConnectionManager> weak = shared_from_this();
+	// the io_service stops when it runs out of work, e.g. while idle
+	if (mClient.getClient().stopped()) mClient.getClient().reset();
+	mClient.getClient().get_io_service().post([weak, aStep]() {
+		if (auto manager = weak.lock()) aStep(*manager);
+	});
+}
+
+void VDConnectionManager::start() {
+	post([](VDConnectionManager &manager) {
+		if (manager.mState == IDLE) manager.resolve();
+	});
+}
+
+void VDConnectionManager::stop() {
+	post([](VDConnectionManager &manager) {
+		State state = manager.getState();
+		manager.mState = IDLE;
+		asio::error_code err;
+		manager.mTimer.cancel(err);
+		manager.mResolver.cancel();
+		if (state == OPEN) manager.mClient.disconnect();
+	});
+}
+
+void VDConnectionManager::resolve() {
+	mState = RESOLVING;
+	string endpoint;
+	{
+		lock_guard<mutex> lock(mEndpointMutex);
+		mEndpointIndex %= mEndpoints.size();
+		endpoint = mEndpoints[mEndpointIndex];
+		mEndpoint = endpoint;
+	}
+	websocketpp::uri uri(endpoint);
+	if (!uri.get_valid()) {
+		CI_LOG_W("VDConnectionManager invalid endpoint " << endpoint);
+		backoff(true);
+		return;
+	}
+	auto cached = mResolveCache.find(uri.get_host_port());
+	if (cached != mResolveCache.end() && cached->second.expires > chrono::steady_clock::now()) {
+		connect(cached->second.address);
+		return;
+	}
+	weak_ptr<VDConnectionManager> weak = shared_from_this();
+	asio::ip::tcp::resolver::query query(uri.get_host(), uri.get_port_str());
+	mResolver.async_resolve(query, [weak, uri](const asio::error_code &aError, asio::ip::tcp::resolver::iterator aIterator) {
+		auto manager = weak.lock();
+		if (!manager || aError == asio::error::operation_aborted || manager->mState != RESOLVING) return;
+		if (aError || aIterator == asio::ip::tcp::resolver::iterator()) {
+			manager->backoff(true);
+			return;
+		}
+		asio::ip::address address = aIterator->endpoint().address();
+		CachedAddress &entry = manager->mResolveCache[uri.get_host_port()];
+		entry.address = address.is_v6() ? "[" + address.to_string() + "]" : address.to_string();
+		entry.expires = chrono::steady_clock::now() + chrono::seconds(kResolveCacheSeconds);
+		manager->connect(entry.address);
+	});
+}
+
+void VDConnectionManager::connect(const string &aAddress) {
+	mState = CONNECTING;
+	mAttempts++;
+	websocketpp::uri uri(mEndpoint);
+	// the resolved address replaces the host name, websocketpp would resolve it again
+	string address = (uri.get_secure() ? "wss://" : "ws://") + aAddress + ":" + uri.get_port_str() + uri.get_resource();
+	mClient.connect(address);
+}
+
+void VDConnectionManager::backoff(bool aNextEndpoint) {
+	mState = BACKOFF;
+	if (aNextEndpoint) {
+		lock_guard<mutex> lock(mEndpointMutex);
+		mEndpointIndex++;
+	}
+	// full jitter between half and all of the exponential delay
+	int delay = kBackoffMin << min(mFailures, 7);
+	delay = min(delay, kBackoffMax);
+	delay = uniform_int_distribution<int>(delay / 2, delay)(mRandom);
+	mFailures++;
+	weak_ptr<VDConnectionManager> weak = shared_from_this();
+	mTimer.expires_from_now(chrono::milliseconds(delay));
+	mTimer.async_wait([weak](const asio::error_code &aError) {
+		auto manager = weak.lock();
+		if (!manager || aError || manager->mState != BACKOFF) return;
+		manager->resolve();
+	});
+}
+
+void VDConnectionManager::onOpen() {
+	mState = OPEN;
+	mFailures = 0;
+}
+
+void VDConnectionManager::onClose() {
+	if (mState != OPEN) return;
+	// the router went away, first retry comes quickly and keeps the endpoint
+	mFailures = 0;
+	backoff(false);
+}
+
+void VDConnectionManager::onFail(const string &aError) {
+	// write and ping errors are reported through the same handler
+	if (mState != CONNECTING) return;
+	// the address may have changed
+	{
+		websocketpp::uri uri(mEndpoint);
+		mResolveCache.erase(uri.get_host_port());
+	}
+	backoff(true);
+}
@@ -0,0 +1,155 @@
+#include "VDJitterBuffer.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#if defined( _M_X64 ) || defined( __x86_64__ ) || defined( _M_IX86 ) || defined( __i386__ )
+	#define VD_JITTER_SSE
+	#include <emmintrin.h>
+#endif
+
+using namespace ci;
+using namespace std;
+using namespace videodromm;
+
+VDJitterBuffer::VDJitterBuffer(uint64_t aDelayMicros)
+	: mDelay(aDelayMicros), mQueue(4096), mHasOffset(false), mOffset(0), mWindowOffset(LLONG_MAX), mWindowStart(0),
+	mLastPlayout(0), mSamples(0), mOverflows(0), mLate(0) {
+	memset(mFromTime, 0, sizeof(mFromTime));
+	memset(mToTime, 0, sizeof(mToTime));
+	memset(mFrom, 0, sizeof(mFrom));
+	memset(mTo, 0, sizeof(mTo));
+	memset(mWeight, 0, sizeof(mWeight));
+	memset(mOut, 0, sizeof(mOut));
+	memset(mWritten, 0, sizeof(mWritten));
+}
+
+uint64_t VDJitterBuffer::toLocalTime(uint64_t aArrival, uint64_t aSenderTime) {
+	if (aSenderTime == 0) return aArrival;
+	// the fastest message defines the offset, slower ones keep their sender spacing
+	int64_t offset = (int64_t)(aArrival - aSenderTime);
+	if (!mHasOffset || offset < mOffset) {
+		mOffset = offset;
+		mHasOffset = true;
+	}
+	if (offset < mWindowOffset) mWindowOffset = offset;
+	if (aArrival - mWindowStart > kOffsetWindow) {
+		mOffset = mWindowOffset;
+		mWindowOffset = LLONG_MAX;
+		mWindowStart = aArrival;
+	}
+	return aSenderTime + mOffset;
+}
+
+void VDJitterBuffer::push(size_t aLane, float aValue, uint64_t aTime) {
+	VDJitterSample sample;
+	sample.lane = (uint16_t)aLane;
+	sample.value = aValue;
+	sample.time = aTime;
+	if (mQueue.push(std::move(sample))) mSamples++;
+	else mOverflows++;
+}
+
+void VDJitterBuffer::pushFloat(unsigned int aIndex, float aValue, uint64_t aArrival, uint64_t aSenderTime) {
+	if (aIndex >= kFloatLanes) return;
+	push(aIndex, aValue, toLocalTime(aArrival, aSenderTime));
+}
+
+void VDJitterBuffer::pushVec4(unsigned int aIndex, const vec4 &aValue, uint64_t aArrival, uint64_t aSenderTime) {
+	if (aIndex >= kFloatLanes) return;
+	uint64_t time = toLocalTime(aArrival, aSenderTime);
+	for (int i = 0; i < 4; i++) push(kFloatLanes + aIndex * 4 + i, aValue[i], time);
+}
+
+void VDJitterBuffer::playout(uint64_t aNow, VDUniformTable &aTable) {
+	uint64_t delay = mDelay.load(memory_order_relaxed);
+	uint64_t playoutTime = aNow > delay ? aNow - delay : 0;
+	VDJitterSample sample;
+	while (mQueue.pop(sample)) mPending.push_back(sample);
+	// sender timestamps can arrive out of order
+	auto earlier = [](const VDJitterSample &a, const VDJitterSample &b) { return a.time < b.time; };
+	if (!is_sorted(mPending.begin(), mPending.end(), earlier)) stable_sort(mPending.begin(), mPending.end(), earlier);
+
+	// samples due by now become the start point of their lane
+	size_t due = 0;
+	for (; due < mPending.size() && mPending[due].time <= playoutTime; due++) {
+		const VDJitterSample &s = mPending[due];
+		if (s.time < mLastPlayout) mLate++;
+		mFrom[s.lane] = s.value;
+		mFromTime[s.lane] = s.time;
+		if (!mActive[s.lane]) {
+			mActive.set(s.lane);
+			mActiveLanes.push_back(s.lane);
+		}
+	}
+	mPending.erase(mPending.begin(), mPending.begin() + due);
+	mLastPlayout = playoutTime;
+
+	// the next pending sample is the target, lanes without one hold their value
+	for (uint16_t lane : mActiveLanes) {
+		mTo[lane] = mFrom[lane];
+		mToTime[lane] = 0;
+		mWeight[lane] = 0.0f;
+	}
+	for (const VDJitterSample &s : mPending) {
+		if (mActive[s.lane] && mToTime[s.lane] == 0) {
+			mTo[s.lane] = s.value;
+			mToTime[s.lane] = s.time;
+		}
+	}
+	for (uint16_t lane : mActiveLanes) {
+		if (mToTime[lane] == 0) continue;
+		uint64_t span = mToTime[lane] - mFromTime[lane];
+		mWeight[lane] = span > 0 ? (float)(playoutTime - mFromTime[lane]) / (float)span : 1.0f;
+	}
+	interpolate();
+
+	// only lanes that moved are written, vec4 lanes as a whole.
+	// stamped with the oldest sample involved, for the latency stats
+	mChanged.clear();
+	uint64_t oldest = 0;
+	for (uint16_t lane : mActiveLanes) {
+		if (mOut[lane] == mWritten[lane]) continue;
+		mWritten[lane] = mOut[lane];
+		mChanged.push_back(lane);
+		if (oldest == 0 || mFromTime[lane] < oldest) oldest = mFromTime[lane];
+	}
+	if (mChanged.empty()) return;
+	aTable.setReceiveTime(oldest);
+	std::bitset<kFloatLanes> vec4Changed;
+	for (uint16_t lane : mChanged) {
+		if (lane < kFloatLanes) aTable.setFloat(lane, mOut[lane]);
+		else vec4Changed.set((lane - kFloatLanes) / 4);
+	}
+	if (vec4Changed.any()) {
+		for (size_t i = 0; i < kFloatLanes; i++) {
+			if (!vec4Changed[i]) continue;
+			const float *v = &mOut[kFloatLanes + i * 4];
+			aTable.setVec4((unsigned int)i, vec4(v[0], v[1], v[2], v[3]));
+		}
+	}
+}
+
+void VDJitterBuffer::interpolate() {
+	// out = from + (to - from) * weight over every lane, idle lanes have to == from
+	size_t i = 0;
+#if defined( VD_JITTER_SSE )
+	for (; i + 4 <= kLanes; i += 4) {
+		__m128 from = _mm_loadu_ps(mFrom + i);
+		__m128 to = _mm_loadu_ps(mTo + i);
+		__m128 weight = _mm_loadu_ps(mWeight + i);
+		_mm_storeu_ps(mOut + i, _mm_add_ps(from, _mm_mul_ps(_mm_sub_ps(to, from), weight)));
+	}
+#endif
+	for (; i < kLanes; i++) mOut[i] = mFrom[i] + (mTo[i] - mFrom[i]) * mWeight[i];
+}
+
+VDJitterStats VDJitterBuffer::getStats() const {
+	VDJitterStats stats;
+	stats.samples = mSamples.load();
+	stats.overflows = mOverflows.load();
+	stats.late = mLate.load();
+	stats.delay = mDelay.load();
+	return stats;
+}
@@ -0,0 +1,321 @@
+#include "VDJsonReader.h"
+
+using namespace videodromm;
+
+namespace {
+	const double kPowersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+
+	inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+	double powerOfTen(int aExponent) {
+		double result = 1.0;
+		bool negative = aExponent < 0;
+		if (negative) aExponent = -aExponent;
+		while (aExponent > 18) { result *= 1e18; aExponent -= 18; }
+		result *= kPowersOfTen[aExponent];
+		return negative ? 1.0 / result : result;
+	}
+
+	int hexValue(char c) {
+		if (c >= '0' && c <= '9') return c - '0';
+		if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+		return -1;
+	}
+
+	void appendUtf8(unsigned int aCodePoint, std::string &aOut) {
+		if (aCodePoint < 0x80) {
+			aOut += (char)aCodePoint;
+		}
+		else if (aCodePoint < 0x800) {
+			aOut += (char)(0xC0 | (aCodePoint >> 6));
+			aOut += (char)(0x80 | (aCodePoint & 0x3F));
+		}
+		else if (aCodePoint < 0x10000) {
+			aOut += (char)(0xE0 | (aCodePoint >> 12));
+			aOut += (char)(0x80 | ((aCodePoint >> 6) & 0x3F));
+			aOut += (char)(0x80 | (aCodePoint & 0x3F));
+		}
+		else {
+			aOut += (char)(0xF0 | (aCodePoint >> 18));
+			aOut += (char)(0x80 | ((aCodePoint >> 12) & 0x3F));
+			aOut += (char)(0x80 | ((aCodePoint >> 6) & 0x3F));
+			aOut += (char)(0x80 | (aCodePoint & 0x3F));
+		}
+	}
+}
+
+VDJsonReader::VDJsonReader(const char *aBegin, const char *aEnd)
+	: mPos(aBegin), mEnd(aEnd), mFailed(false), mFirst(false) {
+}
+
+VDJsonReader::VDJsonReader(const VDStringRef &aSpan)
+	: mPos(aSpan.data), mEnd(aSpan.data + aSpan.size), mFailed(false), mFirst(false) {
+}
+
+void VDJsonReader::skipWhitespace() {
+	while (mPos < mEnd && (*mPos == ' ' || *mPos == '\t' || *mPos == '\n' || *mPos == '\r')) mPos++;
+}
+
+bool VDJsonReader::fail() {
+	mFailed = true;
+	mPos = mEnd;
+	return false;
+}
+
+bool VDJsonReader::expect(char aChar) {
+	skipWhitespace();
+	if (mPos >= mEnd || *mPos != aChar) return fail();
+	mPos++;
+	return true;
+}
+
+char VDJsonReader::peek() {
+	skipWhitespace();
+	return mPos < mEnd ? *mPos : '\0';
+}
+
+const char * VDJsonReader::findStringEnd(const char *aFrom) {
+	// memchr for the quote, then make sure it is not escaped: base64 canvas strings are megabytes long
+	const char *p = aFrom;
+	while (p < mEnd) {
+		const char *quote = (const char *)memchr(p, '"', mEnd - p);
+		if (!quote) return nullptr;
+		const char *b = quote;
+		while (b > aFrom && *(b - 1) == '\\') b--;
+		if (((quote - b) & 1) == 0) return quote;
+		p = quote + 1;
+	}
+	return nullptr;
+}
+
+bool VDJsonReader::separator() {
+	if (mFirst) {
+		mFirst = false;
+		return *mPos == ',' ? fail() : true;
+	}
+	if (*mPos != ',') return fail();
+	mPos++;
+	skipWhitespace();
+	return mPos < mEnd ? true : fail();
+}
+
+bool VDJsonReader::beginObject() {
+	mFirst = true;
+	return expect('{');
+}
+
+bool VDJsonReader::beginArray() {
+	mFirst = true;
+	return expect('[');
+}
+
+bool VDJsonReader::nextKey(VDStringRef &aKey) {
+	if (mFailed) return false;
+	skipWhitespace();
+	if (mPos >= mEnd) return fail();
+	if (*mPos == '}') {
+		// the object is done, the next member of its parent needs a comma
+		mPos++;
+		mFirst = false;
+		return false;
+	}
+	if (!separator()) return false;
+	if (!readString(aKey)) return false;
+	if (!expect(':')) return false;
+	skipWhitespace();
+	return true;
+}
+
+bool VDJsonReader::nextElement() {
+	if (mFailed) return false;
+	skipWhitespace();
+	if (mPos >= mEnd) return fail();
+	if (*mPos == ']') {
+		mPos++;
+		mFirst = false;
+		return false;
+	}
+	return separator();
+}
+
+bool VDJsonReader::readString(VDStringRef &aRaw) {
+	if (!expect('"')) return false;
+	const char *end = findStringEnd(mPos);
+	if (!end) return fail();
+	aRaw = VDStringRef(mPos, end - mPos);
+	mPos = end + 1;
+	return true;
+}
+
+size_t VDJsonReader::parseFloat(const char *aBegin, const char *aEnd, float &aValue) {
+	const char *p = aBegin;
+	bool negative = false;
+	if (p < aEnd && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		p++;
+	}
+	double mantissa = 0.0;
+	int digits = 0;
+	int exponent = 0;
+	while (p < aEnd && isDigit(*p)) {
+		mantissa = mantissa * 10.0 + (*p - '0');
+		p++;
+		digits++;
+	}
+	if (p < aEnd && *p == '.') {
+		p++;
+		while (p < aEnd && isDigit(*p)) {
+			mantissa = mantissa * 10.0 + (*p - '0');
+			exponent--;
+			p++;
+			digits++;
+		}
+	}
+	if (digits == 0) return 0;
+	if (p < aEnd && (*p == 'e' || *p == 'E')) {
+		const char *e = p + 1;
+		bool negativeExponent = false;
+		if (e < aEnd && (*e == '-' || *e == '+')) {
+			negativeExponent = (*e == '-');
+			e++;
+		}
+		int value = 0;
+		int exponentDigits = 0;
+		while (e < aEnd && isDigit(*e)) {
+			if (value < 1000) value = value * 10 + (*e - '0');
+			e++;
+			exponentDigits++;
+		}
+		if (exponentDigits > 0) {
+			exponent += negativeExponent ? -value : value;
+			p = e;
+		}
+	}
+	if (exponent != 0) mantissa *= powerOfTen(exponent);
+	aValue = (float)(negative ? -mantissa : mantissa);
+	return p - aBegin;
+}
+
+bool VDJsonReader::readFloat(float &aValue) {
+	skipWhitespace();
+	if (mPos >= mEnd) return fail();
+	if (*mPos == '"') {
+		VDStringRef raw;
+		if (!readString(raw)) return false;
+		if (parseFloat(raw.data, raw.data + raw.size, aValue) == 0) return fail();
+		return true;
+	}
+	size_t consumed = parseFloat(mPos, mEnd, aValue);
+	if (consumed == 0) return fail();
+	mPos += consumed;
+	return true;
+}
+
+bool VDJsonReader::readInt(int &aValue) {
+	float value;
+	if (!readFloat(value)) return false;
+	// converting anything out of range (or nan) to int is undefined
+	if (!(value >= -2147483648.0f && value < 2147483648.0f)) return false;
+	aValue = (int)value;
+	return true;
+}
+
+bool VDJsonReader::readValue(VDStringRef &aSpan) {
+	skipWhitespace();
+	const char *start = mPos;
+	if (!skipValue()) return false;
+	aSpan = VDStringRef(start, mPos - start);
+	return true;
+}
+
+bool VDJsonReader::skipValue() {
+	skipWhitespace();
+	if (mPos >= mEnd) return fail();
+	char c = *mPos;
+	if (c == '"') {
+		VDStringRef raw;
+		return readString(raw);
+	}
+	if (c == '{' || c == '[') {
+		int depth = 0;
+		while (mPos < mEnd) {
+			c = *mPos;
+			if (c == '"') {
+				const char *end = findStringEnd(mPos + 1);
+				if (!end) return fail();
+				mPos = end + 1;
+				continue;
+			}
+			if (c == '{' || c == '[') depth++;
+			else if (c == '}' || c == ']') {
+				depth--;
+				if (depth == 0) {
+					mPos++;
+					return true;
+				}
+			}
+			mPos++;
+		}
+		return fail();
+	}
+	// number or literal
+	const char *start = mPos;
+	while (mPos < mEnd && *mPos != ',' && *mPos != '}' && *mPos != ']' && *mPos != ' ' && *mPos != '\t' && *mPos != '\n' && *mPos != '\r') mPos++;
+	return mPos > start ? true : fail();
+}
+
+void VDJsonReader::unescape(const VDStringRef &aRaw, std::string &aOut) {
+	// clear() keeps the capacity, so a reused buffer stops allocating after warm-up
+	aOut.clear();
+	const char *p = aRaw.data;
+	const char *end = aRaw.data + aRaw.size;
+	while (p < end) {
+		const char *slash = (const char *)memchr(p, '\\', end - p);
+		if (!slash) {
+			aOut.append(p, end - p);
+			return;
+		}
+		aOut.append(p, slash - p);
+		p = slash + 1;
+		if (p >= end) return;
+		switch (*p) {
+		case 'n': aOut += '\n'; break;
+		case 't': aOut += '\t'; break;
+		case 'r': aOut += '\r'; break;
+		case 'b': aOut += '\b'; break;
+		case 'f': aOut += '\f'; break;
+		case 'u': {
+			unsigned int codePoint = 0;
+			int i = 0;
+			for (; i < 4 && p + 1 + i < end; i++) {
+				int h = hexValue(p[1 + i]);
+				if (h < 0) break;
+				codePoint = (codePoint << 4) | h;
+			}
+			p += i;
+			// surrogate pair
+			if (codePoint >= 0xD800 && codePoint <= 0xDBFF && p + 6 < end && p[1] == '\\' && p[2] == 'u') {
+				unsigned int low = 0;
+				int j = 0;
+				for (; j < 4; j++) {
+					int h = hexValue(p[3 + j]);
+					if (h < 0) break;
+					low = (low << 4) | h;
+				}
+				if (j == 4 && low >= 0xDC00 && low <= 0xDFFF) {
+					codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+					p += 6;
+				}
+			}
+			appendUtf8(codePoint, aOut);
+			break;
+		}
+		default:
+			// \" \\ \/
+			aOut += *p;
+			break;
+		}
+		p++;
+	}
+}
@@ -0,0 +1,149 @@
+#include "VDLatency.h"
+
+#include "cinder/Log.h"
+
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#if defined( _MSC_VER )
+	#include <intrin.h>
+#endif
+
+using namespace ci;
+using namespace std;
+using namespace videodromm;
+
+namespace {
+	unsigned int highestBit(uint64_t aValue) {
+	#if defined( _MSC_VER )
+		unsigned long index;
+		_BitScanReverse64(&index, aValue);
+		return (unsigned int)index;
+	#else
+		return 63 - (unsigned int)__builtin_clzll(aValue);
+	#endif
+	}
+}
+
+VDLatencyHistogram::VDLatencyHistogram() {
+	reset();
+}
+
+size_t VDLatencyHistogram::getIndex(uint64_t aMicros) {
+	if (aMicros < kLinear) return (size_t)aMicros;
+	if (aMicros >= (1ULL << kMaxBits)) aMicros = (1ULL << kMaxBits) - 1;
+	// the top kSubBits + 1 bits select the octave and the sub-bucket within it
+	unsigned int bit = highestBit(aMicros);
+	unsigned int shift = bit - kSubBits;
+	size_t sub = (size_t)(aMicros >> shift) - (1 << kSubBits);
+	return kLinear + (size_t)(bit - kSubBits - 1) * (1 << kSubBits) + sub;
+}
+
+uint64_t VDLatencyHistogram::getUpperBound(size_t aIndex) {
+	if (aIndex < kLinear) return aIndex;
+	size_t octave = (aIndex - kLinear) >> kSubBits;
+	size_t sub = (aIndex - kLinear) & ((1 << kSubBits) - 1);
+	unsigned int shift = (unsigned int)octave + 1;
+	return (((uint64_t)(1 << kSubBits) + sub) << shift) + (1ULL << shift) - 1;
+}
+
+void VDLatencyHistogram::record(uint64_t aMicros) {
+	mBuckets[getIndex(aMicros)].fetch_add(1, memory_order_relaxed);
+	mCount.fetch_add(1, memory_order_relaxed);
+	mSum.fetch_add(aMicros, memory_order_relaxed);
+	uint64_t max = mMax.load(memory_order_relaxed);
+	while (aMicros > max && !mMax.compare_exchange_weak(max, aMicros, memory_order_relaxed)) {}
+}
+
+uint64_t VDLatencyHistogram::getPercentile(double aPercentile) const {
+	uint64_t count = getCount();
+	if (count == 0) return 0;
+	uint64_t target = (uint64_t)ceil(count * aPercentile / 100.0);
+	if (target == 0) target = 1;
+	uint64_t seen = 0;
+	for (size_t i = 0; i < kBuckets; i++) {
+		seen += mBuckets[i].load(memory_order_relaxed);
+		// never report more than the largest sample
+		if (seen >= target) return min(getUpperBound(i), mMax.load(memory_order_relaxed));
+	}
+	return mMax.load(memory_order_relaxed);
+}
+
+VDLatencySummary VDLatencyHistogram::getSummary() const {
+	VDLatencySummary summary;
+	summary.count = getCount();
+	summary.p50 = getPercentile(50.0);
+	summary.p90 = getPercentile(90.0);
+	summary.p99 = getPercentile(99.0);
+	summary.p999 = getPercentile(99.9);
+	summary.max = mMax.load(memory_order_relaxed);
+	summary.mean = summary.count ? (double)mSum.load(memory_order_relaxed) / summary.count : 0.0;
+	return summary;
+}
+
+void VDLatencyHistogram::reset() {
+	for (auto &bucket : mBuckets) bucket.store(0, memory_order_relaxed);
+	mCount = 0;
+	mSum = 0;
+	mMax = 0;
+}
+
+VDLatencyTracker::VDLatencyTracker()
+	: mLogInterval(0.0), mLastLog(0.0) {
+}
+
+const char * VDLatencyTracker::getTypeName(Type aType) {
+	switch (aType) {
+	case UNIFORMS: return "uniforms";
+	case CANVAS: return "canvas";
+	case SHADER: return "shader";
+	default: return "other";
+	}
+}
+
+const char * VDLatencyTracker::getStageName(Stage aStage) {
+	switch (aStage) {
+	case PARSED: return "parsed";
+	case APPLIED: return "applied";
+	default: return "presented";
+	}
+}
+
+void VDLatencyTracker::record(Type aType, Stage aStage, uint64_t aReceived, uint64_t aNow) {
+	if (aReceived == 0) return;
+	mHistograms[aType][aStage].record(aNow > aReceived ? aNow - aReceived : 0);
+}
+
+void VDLatencyTracker::reset() {
+	for (auto &type : mHistograms) {
+		for (auto &histogram : type) histogram.reset();
+	}
+}
+
+void VDLatencyTracker::update(double aElapsedSeconds) {
+	if (mLogInterval <= 0.0 || aElapsedSeconds - mLastLog < mLogInterval) return;
+	mLastLog = aElapsedSeconds;
+	string report = getReport();
+	if (!report.empty()) CI_LOG_I("latency since start, ms\n" << report);
+}
+
+string VDLatencyTracker::getReport() const {
+	// one line per type and stage that has samples
+	stringstream ss;
+	ss << fixed << setprecision(2);
+	for (int type = 0; type < TYPE_COUNT; type++) {
+		for (int stage = 0; stage < STAGE_COUNT; stage++) {
+			VDLatencySummary summary = mHistograms[type][stage].getSummary();
+			if (summary.count == 0) continue;
+			ss << getTypeName((Type)type) << " " << getStageName((Stage)stage)
+				<< " n " << summary.count
+				<< " p50 " << summary.p50 / 1000.0
+				<< " p90 " << summary.p90 / 1000.0
+				<< " p99 " << summary.p99 / 1000.0
+				<< " p99.9 " << summary.p999 / 1000.0
+				<< " max " << summary.max / 1000.0 << "\n";
+		}
+	}
+	return ss.str();
+}
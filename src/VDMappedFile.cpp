@@ -0,0 +1,156 @@
+#include "VDMappedFile.h"
+
+#if defined( CINDER_MSW )
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif
+
+using namespace ci;
+using namespace videodromm;
+
+#if defined( CINDER_MSW )
+
+VDMappedFile::VDMappedFile()
+	: mData(nullptr), mSize(0), mWritable(false), mFile(INVALID_HANDLE_VALUE), mMapping(nullptr) {
+}
+
+bool VDMappedFile::openRead(const fs::path &aPath) {
+	close();
+	mWritable = false;
+	mFile = CreateFileW(aPath.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (mFile == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(mFile, &size) || size.QuadPart == 0) {
+		close();
+		return false;
+	}
+	return map((size_t)size.QuadPart);
+}
+
+bool VDMappedFile::openWrite(const fs::path &aPath, size_t aSize) {
+	close();
+	mWritable = true;
+	mFile = CreateFileW(aPath.wstring().c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (mFile == INVALID_HANDLE_VALUE) return false;
+	return map(aSize);
+}
+
+bool VDMappedFile::map(size_t aSize) {
+	// a writable mapping larger than the file extends it
+	uint64_t size = aSize;
+	mMapping = CreateFileMappingW(mFile, nullptr, mWritable ? PAGE_READWRITE : PAGE_READONLY, (DWORD)(size >> 32), (DWORD)size, nullptr);
+	if (!mMapping) {
+		close();
+		return false;
+	}
+	mData = (uint8_t *)MapViewOfFile(mMapping, mWritable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, aSize);
+	if (!mData) {
+		close();
+		return false;
+	}
+	mSize = aSize;
+	return true;
+}
+
+void VDMappedFile::unmap() {
+	if (mData) UnmapViewOfFile(mData);
+	if (mMapping) CloseHandle(mMapping);
+	mData = nullptr;
+	mMapping = nullptr;
+	mSize = 0;
+}
+
+void VDMappedFile::close(size_t aUsedSize) {
+	unmap();
+	if (mFile != INVALID_HANDLE_VALUE) {
+		if (mWritable) {
+			LARGE_INTEGER end;
+			end.QuadPart = (LONGLONG)aUsedSize;
+			SetFilePointerEx(mFile, end, nullptr, FILE_BEGIN);
+			SetEndOfFile(mFile);
+		}
+		CloseHandle(mFile);
+	}
+	mFile = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+VDMappedFile::VDMappedFile()
+	: mData(nullptr), mSize(0), mWritable(false), mFile(-1) {
+}
+
+bool VDMappedFile::openRead(const fs::path &aPath) {
+	close();
+	mWritable = false;
+	mFile = ::open(aPath.string().c_str(), O_RDONLY);
+	if (mFile < 0) return false;
+	off_t size = lseek(mFile, 0, SEEK_END);
+	if (size <= 0) {
+		close();
+		return false;
+	}
+	return map((size_t)size);
+}
+
+bool VDMappedFile::openWrite(const fs::path &aPath, size_t aSize) {
+	close();
+	mWritable = true;
+	mFile = ::open(aPath.string().c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (mFile < 0) return false;
+	return map(aSize);
+}
+
+bool VDMappedFile::map(size_t aSize) {
+	if (mWritable && ftruncate(mFile, (off_t)aSize) != 0) {
+		close();
+		return false;
+	}
+	void *data = mmap(nullptr, aSize, mWritable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, mFile, 0);
+	if (data == MAP_FAILED) {
+		close();
+		return false;
+	}
+	mData = (uint8_t *)data;
+	mSize = aSize;
+	return true;
+}
+
+void VDMappedFile::unmap() {
+	if (mData) munmap(mData, mSize);
+	mData = nullptr;
+	mSize = 0;
+}
+
+void VDMappedFile::close(size_t aUsedSize) {
+	unmap();
+	if (mFile >= 0) {
+		if (mWritable) {
+			if (ftruncate(mFile, (off_t)aUsedSize) != 0) {
+				// keep the zero-filled tail, the capture header still knows its length
+			}
+		}
+		::close(mFile);
+	}
+	mFile = -1;
+}
+
+#endif
+
+VDMappedFile::~VDMappedFile() {
+	// a file left open in write mode keeps its mapped size
+	if (mWritable) close(mSize);
+	else close();
+}
+
+bool VDMappedFile::resize(size_t aSize) {
+	if (!mWritable || !isOpen()) return false;
+	unmap();
+	return map(aSize);
+}
@@ -0,0 +1,147 @@
+#include "VDMessageBuilder.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+using namespace videodromm;
+
+VDMessageBuilder::VDMessageBuilder(size_t aReserve)
+	: mMessageCount(0), mDepth(0), mAfterKey(false) {
+	mBuffer.reserve(aReserve);
+	clear();
+}
+
+void VDMessageBuilder::clear() {
+	// the batch array is opened up front, finish() drops it for a single message
+	mBuffer.assign(1, '[');
+	mMessageCount = 0;
+	mDepth = 0;
+	mHasValue[0] = false;
+	mAfterKey = false;
+}
+
+const string & VDMessageBuilder::finish() {
+	if (mMessageCount == 1) {
+		mBuffer.erase(0, 1);
+	}
+	else {
+		mBuffer += ']';
+	}
+	return mBuffer;
+}
+
+void VDMessageBuilder::separate() {
+	if (mAfterKey) {
+		mAfterKey = false;
+		return;
+	}
+	if (mHasValue[mDepth]) mBuffer += ',';
+	mHasValue[mDepth] = true;
+}
+
+void VDMessageBuilder::endValue() {
+	if (mDepth == 0) mMessageCount++;
+}
+
+void VDMessageBuilder::beginObject() {
+	separate();
+	mBuffer += '{';
+	if (mDepth + 1 < kMaxDepth) mDepth++;
+	mHasValue[mDepth] = false;
+}
+
+void VDMessageBuilder::endObject() {
+	mBuffer += '}';
+	if (mDepth > 0) mDepth--;
+	endValue();
+}
+
+void VDMessageBuilder::beginArray() {
+	separate();
+	mBuffer += '[';
+	if (mDepth + 1 < kMaxDepth) mDepth++;
+	mHasValue[mDepth] = false;
+}
+
+void VDMessageBuilder::endArray() {
+	mBuffer += ']';
+	if (mDepth > 0) mDepth--;
+	endValue();
+}
+
+void VDMessageBuilder::key(const char *aKey) {
+	separate();
+	mBuffer += '"';
+	escape(aKey, strlen(aKey));
+	mBuffer += "\":";
+	mAfterKey = true;
+}
+
+void VDMessageBuilder::value(int64_t aValue) {
+	separate();
+	char text[24];
+	int length = snprintf(text, sizeof(text), "%lld", (long long)aValue);
+	mBuffer.append(text, length);
+	endValue();
+}
+
+void VDMessageBuilder::value(double aValue) {
+	separate();
+	char text[32];
+	// same precision as the stringstreams this replaces, json has no nan or inf
+	int length = aValue == aValue && aValue - aValue == 0.0 ? snprintf(text, sizeof(text), "%g", aValue) : snprintf(text, sizeof(text), "0");
+	mBuffer.append(text, length);
+	endValue();
+}
+
+void VDMessageBuilder::value(bool aValue) {
+	separate();
+	mBuffer += aValue ? "true" : "false";
+	endValue();
+}
+
+void VDMessageBuilder::value(const char *aValue) {
+	value(aValue, strlen(aValue));
+}
+
+void VDMessageBuilder::value(const char *aValue, size_t aSize) {
+	separate();
+	mBuffer += '"';
+	escape(aValue, aSize);
+	mBuffer += '"';
+	endValue();
+}
+
+void VDMessageBuilder::raw(const char *aJson, size_t aSize) {
+	separate();
+	mBuffer.append(aJson, aSize);
+	endValue();
+}
+
+void VDMessageBuilder::escape(const char *aValue, size_t aSize) {
+	static const char hex[] = "0123456789abcdef";
+	// copy runs of plain characters at once
+	const char *run = aValue;
+	const char *end = aValue + aSize;
+	for (const char *p = aValue; p < end; p++) {
+		unsigned char c = (unsigned char)*p;
+		if (c >= 0x20 && c != '"' && c != '\\') continue;
+		mBuffer.append(run, p - run);
+		run = p + 1;
+		switch (c) {
+		case '"': mBuffer += "\\\""; break;
+		case '\\': mBuffer += "\\\\"; break;
+		case '\n': mBuffer += "\\n"; break;
+		case '\r': mBuffer += "\\r"; break;
+		case '\t': mBuffer += "\\t"; break;
+		case '\b': mBuffer += "\\b"; break;
+		case '\f': mBuffer += "\\f"; break;
+		default: {
+			char unicode[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+			mBuffer.append(unicode, 6);
+		}
+		}
+	}
+	mBuffer.append(run, end - run);
+}
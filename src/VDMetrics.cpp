@@ -0,0 +1,263 @@
+#include "VDMetrics.h"
+
+#include "VDMessageBuilder.h"
+
+#include <sstream>
+
+using namespace ci;
+using namespace std;
+using namespace videodromm;
+
+namespace {
+	const char *getOpcodeName(size_t aOpcode) {
+		switch (aOpcode) {
+		case websocketpp::frame::opcode::TEXT: return "text";
+		case websocketpp::frame::opcode::BINARY: return "binary";
+		case websocketpp::frame::opcode::CLOSE: return "close";
+		case websocketpp::frame::opcode::PING: return "ping";
+		case websocketpp::frame::opcode::PONG: return "pong";
+		default: return nullptr;
+		}
+	}
+
+	// # HELP and # TYPE lines, once per metric name
+	void header(stringstream &ss, const char *aName, const char *aType, const char *aHelp) {
+		ss << "# HELP hydra_" << aName << " " << aHelp << "\n";
+		ss << "# TYPE hydra_" << aName << " " << aType << "\n";
+	}
+
+	// p50 to max of a microsecond summary as quantile labels, in seconds
+	void quantiles(stringstream &ss, const char *aName, const string &aLabels, const VDLatencySummary &aSummary) {
+		const char *names[] = { "0.5", "0.9", "0.99", "0.999", "1" };
+		uint64_t values[] = { aSummary.p50, aSummary.p90, aSummary.p99, aSummary.p999, aSummary.max };
+		for (int i = 0; i < 5; i++) {
+			ss << "hydra_" << aName << "{" << aLabels << (aLabels.empty() ? "" : ",") << "quantile=\"" << names[i] << "\"} " << values[i] / 1e6 << "\n";
+		}
+	}
+
+	void summary(VDMessageBuilder &aJson, const VDLatencySummary &aSummary) {
+		// milliseconds, like VDLatencyTracker::getReport()
+		aJson.beginObject();
+		aJson.key("count"); aJson.value((int64_t)aSummary.count);
+		aJson.key("p50"); aJson.value(aSummary.p50 / 1000.0);
+		aJson.key("p90"); aJson.value(aSummary.p90 / 1000.0);
+		aJson.key("p99"); aJson.value(aSummary.p99 / 1000.0);
+		aJson.key("p999"); aJson.value(aSummary.p999 / 1000.0);
+		aJson.key("max"); aJson.value(aSummary.max / 1000.0);
+		aJson.key("mean"); aJson.value(aSummary.mean / 1000.0);
+		aJson.endObject();
+	}
+}
+
+VDMetrics::VDMetrics()
+	: mLastFrame(0), mFrames(0) {
+	std::atomic_store(&mSnapshot, VDMetricsSnapshotRef(new VDMetricsSnapshot()));
+}
+
+void VDMetrics::frame(uint64_t aNow) {
+	if (mLastFrame != 0) mFrameTimes.record(aNow - mLastFrame);
+	mLastFrame = aNow;
+	mFrames++;
+}
+
+void VDMetrics::publish(const std::shared_ptr<VDMetricsSnapshot> &aSnapshot) {
+	aSnapshot->frames = mFrames;
+	aSnapshot->frameTime = mFrameTimes.getSummary();
+	mFrameTimes.reset();
+	std::atomic_store(&mSnapshot, VDMetricsSnapshotRef(aSnapshot));
+}
+
+string VDMetrics::renderPrometheus(const VDMetricsSnapshot &aSnapshot) {
+	stringstream ss;
+	header(ss, "uptime_seconds", "gauge", "Seconds since start.");
+	ss << "hydra_uptime_seconds " << aSnapshot.uptime << "\n";
+	header(ss, "frames_total", "counter", "Frames presented.");
+	ss << "hydra_frames_total " << aSnapshot.frames << "\n";
+	header(ss, "frame_time_seconds", "gauge", "Frame to frame time since the previous snapshot.");
+	quantiles(ss, "frame_time_seconds", "", aSnapshot.frameTime);
+
+	header(ss, "latency_seconds", "gauge", "Time from the socket read of a message to each stage.");
+	for (int type = 0; type < VDLatencyTracker::TYPE_COUNT; type++) {
+		for (int stage = 0; stage < VDLatencyTracker::STAGE_COUNT; stage++) {
+			const VDLatencySummary &latency = aSnapshot.latency[type][stage];
+			if (latency.count == 0) continue;
+			string labels = string("type=\"") + VDLatencyTracker::getTypeName((VDLatencyTracker::Type)type)
+				+ "\",stage=\"" + VDLatencyTracker::getStageName((VDLatencyTracker::Stage)stage) + "\"";
+			quantiles(ss, "latency_seconds", labels, latency);
+		}
+	}
+
+	header(ss, "ws_connected", "gauge", "1 while the source is connected.");
+	for (size_t i = 0; i < aSnapshot.sources.size(); i++) {
+		ss << "hydra_ws_connected{source=\"" << i << "\"} " << (aSnapshot.sources[i].connected ? 1 : 0) << "\n";
+	}
+	header(ss, "ws_messages_total", "counter", "Websocket messages by direction and opcode.");
+	for (size_t i = 0; i < aSnapshot.sources.size(); i++) {
+		const WebSocketStats &ws = aSnapshot.sources[i].connection;
+		for (size_t op = 0; op < WebSocketStats::kOpcodeCount; op++) {
+			const char *name = getOpcodeName(op);
+			if (!name) continue;
+			ss << "hydra_ws_messages_total{source=\"" << i << "\",direction=\"in\",opcode=\"" << name << "\"} " << ws.messagesIn[op] << "\n";
+			ss << "hydra_ws_messages_total{source=\"" << i << "\",direction=\"out\",opcode=\"" << name << "\"} " << ws.messagesOut[op] << "\n";
+		}
+	}
+	header(ss, "ws_bytes_total", "counter", "Websocket payload bytes by direction and opcode.");
+	for (size_t i = 0; i < aSnapshot.sources.size(); i++) {
+		const WebSocketStats &ws = aSnapshot.sources[i].connection;
+		for (size_t op = 0; op < WebSocketStats::kOpcodeCount; op++) {
+			const char *name = getOpcodeName(op);
+			if (!name) continue;
+			ss << "hydra_ws_bytes_total{source=\"" << i << "\",direction=\"in\",opcode=\"" << name << "\"} " << ws.bytesIn[op] << "\n";
+			ss << "hydra_ws_bytes_total{source=\"" << i << "\",direction=\"out\",opcode=\"" << name << "\"} " << ws.bytesOut[op] << "\n";
+		}
+	}
+	header(ss, "ws_send_queue_messages", "gauge", "Messages queued but not written to the socket yet.");
+	for (size_t i = 0; i < aSnapshot.sources.size(); i++) {
+		ss << "hydra_ws_send_queue_messages{source=\"" << i << "\"} " << aSnapshot.sources[i].connection.sendQueueDepth << "\n";
+	}
+	header(ss, "ws_send_queue_bytes", "gauge", "Payload bytes queued but not written to the socket yet.");
+	for (size_t i = 0; i < aSnapshot.sources.size(); i++) {
+		ss << "hydra_ws_send_queue_bytes{source=\"" << i << "\"} " << aSnapshot.sources[i].connection.bufferedAmount << "\n";
+	}
+	header(ss, "ws_rtt_seconds", "gauge", "Ping to pong round trip.");
+	for (size_t i = 0; i < aSnapshot.sources.size(); i++) {
+		const WebSocketStats &ws = aSnapshot.sources[i].connection;
+		ss << "hydra_ws_rtt_seconds{source=\"" << i << "\",kind=\"smoothed\"} " << ws.rttSmoothed / 1e6 << "\n";
+		ss << "hydra_ws_rtt_seconds{source=\"" << i << "\",kind=\"last\"} " << ws.rttLast / 1e6 << "\n";
+		ss << "hydra_ws_rtt_seconds{source=\"" << i << "\",kind=\"max\"} " << ws.rttMax / 1e6 << "\n";
+	}
+
+	header(ss, "canvas_frames_total", "counter", "Canvas frames received, superseded before being presented, undecodable and presented.");
+	for (size_t i = 0; i < aSnapshot.sources.size(); i++) {
+		const VDCanvasStats &canvas = aSnapshot.sources[i].canvas;
+		ss << "hydra_canvas_frames_total{source=\"" << i << "\",result=\"received\"} " << canvas.received << "\n";
+		ss << "hydra_canvas_frames_total{source=\"" << i << "\",result=\"dropped\"} " << canvas.dropped << "\n";
+		ss << "hydra_canvas_frames_total{source=\"" << i << "\",result=\"failed\"} " << canvas.failed << "\n";
+		ss << "hydra_canvas_frames_total{source=\"" << i << "\",result=\"presented\"} " << canvas.presented << "\n";
+	}
+	header(ss, "canvas_decode_seconds_total", "counter", "Time spent decoding canvas frames by protocol.");
+	for (size_t i = 0; i < aSnapshot.sources.size(); i++) {
+		const VDCanvasStats &canvas = aSnapshot.sources[i].canvas;
+		ss << "hydra_canvas_decode_seconds_total{source=\"" << i << "\",protocol=\"json\"} " << canvas.jsonDecodeSeconds << "\n";
+		ss << "hydra_canvas_decode_seconds_total{source=\"" << i << "\",protocol=\"binary\"} " << canvas.binaryDecodeSeconds << "\n";
+	}
+
+	header(ss, "jitter_samples_total", "counter", "Samples through the jitter buffer, queue overflows and late samples.");
+	for (size_t i = 0; i < aSnapshot.sources.size(); i++) {
+		const VDJitterStats &jitter = aSnapshot.sources[i].jitter;
+		ss << "hydra_jitter_samples_total{source=\"" << i << "\",result=\"queued\"} " << jitter.samples << "\n";
+		ss << "hydra_jitter_samples_total{source=\"" << i << "\",result=\"overflow\"} " << jitter.overflows << "\n";
+		ss << "hydra_jitter_samples_total{source=\"" << i << "\",result=\"late\"} " << jitter.late << "\n";
+	}
+
+	header(ss, "inbox_dropped_total", "counter", "Events dropped because the render thread inbox was full.");
+	ss << "hydra_inbox_dropped_total " << aSnapshot.inboxDropped << "\n";
+	header(ss, "unhandled_messages_total", "counter", "Messages no handler matched.");
+	ss << "hydra_unhandled_messages_total " << aSnapshot.unhandledMessages << "\n";
+	header(ss, "osc_packets_total", "counter", "Datagrams read by the udp osc listener.");
+	ss << "hydra_osc_packets_total " << aSnapshot.osc.packets << "\n";
+	header(ss, "osc_errors_total", "counter", "Failed receives of the udp osc listener, each one delays the next.");
+	ss << "hydra_osc_errors_total " << aSnapshot.osc.errors << "\n";
+	header(ss, "shader_patches_total", "counter", "Shader patches applied and rejected.");
+	ss << "hydra_shader_patches_total{result=\"applied\"} " << aSnapshot.shaderPatches.applied << "\n";
+	ss << "hydra_shader_patches_total{result=\"rejected\"} " << aSnapshot.shaderPatches.rejected << "\n";
+
+	for (const auto &custom : aSnapshot.custom) {
+		ss << "# TYPE hydra_" << custom.first << " untyped\n";
+		ss << "hydra_" << custom.first << " " << custom.second << "\n";
+	}
+	return ss.str();
+}
+
+string VDMetrics::renderJson(const VDMetricsSnapshot &aSnapshot) {
+	VDMessageBuilder json;
+	json.beginObject();
+	json.key("uptime"); json.value(aSnapshot.uptime);
+	json.key("frames"); json.value((int64_t)aSnapshot.frames);
+	json.key("frameTime"); summary(json, aSnapshot.frameTime);
+	json.key("latency");
+	json.beginObject();
+	for (int type = 0; type < VDLatencyTracker::TYPE_COUNT; type++) {
+		json.key(VDLatencyTracker::getTypeName((VDLatencyTracker::Type)type));
+		json.beginObject();
+		for (int stage = 0; stage < VDLatencyTracker::STAGE_COUNT; stage++) {
+			json.key(VDLatencyTracker::getStageName((VDLatencyTracker::Stage)stage));
+			summary(json, aSnapshot.latency[type][stage]);
+		}
+		json.endObject();
+	}
+	json.endObject();
+	json.key("sources");
+	json.beginArray();
+	for (const VDMetricsSource &source : aSnapshot.sources) {
+		const WebSocketStats &ws = source.connection;
+		json.beginObject();
+		json.key("connected"); json.value(source.connected);
+		json.key("websocket");
+		json.beginObject();
+		for (size_t op = 0; op < WebSocketStats::kOpcodeCount; op++) {
+			const char *name = getOpcodeName(op);
+			if (!name) continue;
+			json.key(name);
+			json.beginObject();
+			json.key("messagesIn"); json.value((int64_t)ws.messagesIn[op]);
+			json.key("bytesIn"); json.value((int64_t)ws.bytesIn[op]);
+			json.key("messagesOut"); json.value((int64_t)ws.messagesOut[op]);
+			json.key("bytesOut"); json.value((int64_t)ws.bytesOut[op]);
+			json.endObject();
+		}
+		json.key("sendQueueDepth"); json.value((int64_t)ws.sendQueueDepth);
+		json.key("bufferedAmount"); json.value((int64_t)ws.bufferedAmount);
+		// milliseconds
+		json.key("rttSmoothed"); json.value(ws.rttSmoothed / 1000.0);
+		json.key("rttLast"); json.value(ws.rttLast / 1000.0);
+		json.key("rttMax"); json.value(ws.rttMax / 1000.0);
+		json.endObject();
+		json.key("canvas");
+		json.beginObject();
+		json.key("received"); json.value((int64_t)source.canvas.received);
+		json.key("dropped"); json.value((int64_t)source.canvas.dropped);
+		json.key("failed"); json.value((int64_t)source.canvas.failed);
+		json.key("presented"); json.value((int64_t)source.canvas.presented);
+		json.endObject();
+		json.key("jitter");
+		json.beginObject();
+		json.key("samples"); json.value((int64_t)source.jitter.samples);
+		json.key("overflows"); json.value((int64_t)source.jitter.overflows);
+		json.key("late"); json.value((int64_t)source.jitter.late);
+		json.key("delay"); json.value(source.jitter.delay / 1000.0);
+		json.endObject();
+		json.endObject();
+	}
+	json.endArray();
+	json.key("inboxDropped"); json.value((int64_t)aSnapshot.inboxDropped);
+	json.key("unhandledMessages"); json.value((int64_t)aSnapshot.unhandledMessages);
+	json.key("oscPackets"); json.value((int64_t)aSnapshot.osc.packets);
+	json.key("oscErrors"); json.value((int64_t)aSnapshot.osc.errors);
+	json.key("shaderPatchesApplied"); json.value((int64_t)aSnapshot.shaderPatches.applied);
+	json.key("shaderPatchesRejected"); json.value((int64_t)aSnapshot.shaderPatches.rejected);
+	json.key("custom");
+	json.beginObject();
+	for (const auto &custom : aSnapshot.custom) {
+		json.key(custom.first.c_str());
+		json.value(custom.second);
+	}
+	json.endObject();
+	json.endObject();
+	return json.finish();
+}
+
+bool VDMetrics::handleRequest(const string &aResource, string &aContentType, string &aBody) const {
+	string path = aResource.substr(0, aResource.find('?'));
+	if (path == "/metrics") {
+		aContentType = "text/plain; version=0.0.4; charset=utf-8";
+		aBody = renderPrometheus(*getSnapshot());
+		return true;
+	}
+	if (path == "/stats") {
+		aContentType = "application/json";
+		aBody = renderJson(*getSnapshot());
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,307 @@
+#include "VDOscDecoder.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+using namespace std;
+using namespace videodromm;
+
+namespace {
+	// osc is big-endian
+	uint32_t readUint32(const uint8_t *p) {
+		return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+	}
+
+	uint64_t readUint64(const uint8_t *p) {
+		return ((uint64_t)readUint32(p) << 32) | readUint32(p + 4);
+	}
+
+	size_t pad4(size_t aSize) {
+		return (aSize + 3) & ~(size_t)3;
+	}
+
+	// null-terminated string padded to 4 bytes, returns the padded size or 0
+	size_t readString(const uint8_t *aData, const uint8_t *aEnd, VDStringRef &aString) {
+		const uint8_t *terminator = (const uint8_t *)memchr(aData, 0, aEnd - aData);
+		if (!terminator) return 0;
+		size_t size = pad4(terminator - aData + 1);
+		if (size > (size_t)(aEnd - aData)) return 0;
+		aString = VDStringRef((const char *)aData, terminator - aData);
+		return size;
+	}
+
+	bool matchBracket(const char *&aPattern, const char *aPatternEnd, char aChar) {
+		// aPattern is past the '[', leaves it past the ']'
+		bool negate = aPattern < aPatternEnd && *aPattern == '!';
+		if (negate) aPattern++;
+		bool matched = false;
+		while (aPattern < aPatternEnd && *aPattern != ']') {
+			if (aPattern + 2 < aPatternEnd && aPattern[1] == '-' && aPattern[2] != ']') {
+				if (aChar >= aPattern[0] && aChar <= aPattern[2]) matched = true;
+				aPattern += 3;
+			}
+			else {
+				if (aChar == *aPattern) matched = true;
+				aPattern++;
+			}
+		}
+		if (aPattern < aPatternEnd) aPattern++;
+		return matched != negate;
+	}
+
+	// runs of '*' and {} groups a pattern may have, each one is a point to backtrack to
+	const int kMaxWildcards = 4;
+
+	// the fewest address characters the pattern needs, and its wildcards. false if malformed
+	bool inspectPattern(const char *p, const char *pEnd, size_t &aMinSize, int &aWildcards) {
+		aMinSize = 0;
+		aWildcards = 0;
+		while (p < pEnd) {
+			if (*p == '*') {
+				aWildcards++;
+				while (p < pEnd && *p == '*') p++;
+				continue;
+			}
+			if (*p == '[') {
+				p = (const char *)memchr(p, ']', pEnd - p);
+				if (!p) return false;
+			}
+			else if (*p == '{') {
+				const char *close = (const char *)memchr(p, '}', pEnd - p);
+				if (!close) return false;
+				// the shortest option
+				size_t shortest = close - p;
+				for (const char *option = p + 1; option <= close; ) {
+					const char *comma = option;
+					while (comma < close && *comma != ',') comma++;
+					shortest = min(shortest, (size_t)(comma - option));
+					option = comma + 1;
+				}
+				aWildcards++;
+				aMinSize += shortest;
+				p = close + 1;
+				continue;
+			}
+			aMinSize++;
+			p++;
+		}
+		return true;
+	}
+
+	bool matchFrom(const char *p, const char *pEnd, const char *a, const char *aEnd) {
+		// the last '*' of the current segment and where its match ends: on a mismatch it takes
+		// one more character and matching resumes after it, no recursion per star
+		const char *starP = nullptr;
+		const char *starA = nullptr;
+		while (true) {
+			bool matched;
+			if (p == pEnd) {
+				if (a == aEnd) return true;
+				matched = false;
+			}
+			else if (*p == '*') {
+				while (p < pEnd && *p == '*') p++;
+				starP = p;
+				starA = a;
+				continue;
+			}
+			else if (*p == '?') {
+				matched = a != aEnd && *a != '/';
+				if (matched) {
+					p++;
+					a++;
+				}
+			}
+			else if (*p == '[') {
+				const char *next = p + 1;
+				matched = a != aEnd && *a != '/' && matchBracket(next, pEnd, *a);
+				if (matched) {
+					p = next;
+					a++;
+				}
+			}
+			else if (*p == '{') {
+				// the rest of the pattern decides between the options
+				const char *close = (const char *)memchr(p, '}', pEnd - p);
+				if (!close) return false;
+				for (const char *option = p + 1; option <= close; ) {
+					const char *comma = option;
+					while (comma < close && *comma != ',') comma++;
+					size_t length = comma - option;
+					if ((size_t)(aEnd - a) >= length && memcmp(option, a, length) == 0 && matchFrom(close + 1, pEnd, a + length, aEnd)) return true;
+					option = comma + 1;
+				}
+				matched = false;
+			}
+			else {
+				matched = a != aEnd && *a == *p;
+				if (matched) {
+					// a star before a '/' can't take more than its segment
+					if (*p == '/') starP = nullptr;
+					p++;
+					a++;
+				}
+			}
+			if (matched) continue;
+			// '*' never crosses a '/'
+			if (!starP || starA == aEnd || *starA == '/') return false;
+			starA++;
+			p = starP;
+			a = starA;
+		}
+	}
+}
+
+bool VDOscArgument::toFloat(float &aValue) const {
+	switch (type) {
+	case 'f': aValue = f; return true;
+	case 'i': aValue = (float)i; return true;
+	case 'h': aValue = (float)h; return true;
+	case 'd': aValue = (float)d; return true;
+	case 'T': aValue = 1.0f; return true;
+	case 'F': aValue = 0.0f; return true;
+	default: return false;
+	}
+}
+
+bool VDOscArgument::toInt(int &aValue) const {
+	// peer values: out of range (or nan) is undefined or wraps, refused like VDJsonReader::readInt()
+	switch (type) {
+	case 'i': aValue = i; return true;
+	case 'h':
+		if (h < INT_MIN || h > INT_MAX) return false;
+		aValue = (int)h;
+		return true;
+	case 'f':
+		if (!(f >= -2147483648.0f && f < 2147483648.0f)) return false;
+		aValue = (int)f;
+		return true;
+	case 'd':
+		if (!(d >= -2147483648.0 && d < 2147483648.0)) return false;
+		aValue = (int)d;
+		return true;
+	case 'T': aValue = 1; return true;
+	case 'F': aValue = 0; return true;
+	default: return false;
+	}
+}
+
+bool VDOscMessage::nextArgument(VDOscArgument &aArgument) {
+	if (mFailed || mTypeTags >= mTypeTagsEnd) return false;
+	aArgument.type = *mTypeTags++;
+	size_t remaining = mEnd - mData;
+	switch (aArgument.type) {
+	case 'i':
+	case 'c':
+	case 'r':
+	case 'm':
+		if (remaining < 4) break;
+		aArgument.i = (int32_t)readUint32(mData);
+		mData += 4;
+		return true;
+	case 'f': {
+		if (remaining < 4) break;
+		uint32_t bits = readUint32(mData);
+		memcpy(&aArgument.f, &bits, 4);
+		mData += 4;
+		return true;
+	}
+	case 'h':
+	case 't':
+		if (remaining < 8) break;
+		aArgument.h = (int64_t)readUint64(mData);
+		mData += 8;
+		return true;
+	case 'd': {
+		if (remaining < 8) break;
+		uint64_t bits = readUint64(mData);
+		memcpy(&aArgument.d, &bits, 8);
+		mData += 8;
+		return true;
+	}
+	case 's':
+	case 'S': {
+		size_t size = readString(mData, mEnd, aArgument.s);
+		if (size == 0) break;
+		mData += size;
+		return true;
+	}
+	case 'b': {
+		if (remaining < 4) break;
+		size_t size = readUint32(mData);
+		if (pad4(size) > remaining - 4) break;
+		aArgument.s = VDStringRef((const char *)mData + 4, size);
+		mData += 4 + pad4(size);
+		return true;
+	}
+	case 'T':
+	case 'F':
+	case 'N':
+	case 'I':
+	case '[':
+	case ']':
+		// no data
+		return true;
+	default:
+		// unknown type, the size of its data is unknown too
+		break;
+	}
+	mFailed = true;
+	return false;
+}
+
+bool VDOscDecoder::isPacket(const void *aData, size_t aSize) {
+	const char *data = (const char *)aData;
+	return (aSize >= 4 && data[0] == '/') || (aSize >= 16 && memcmp(data, "#bundle", 8) == 0);
+}
+
+bool VDOscDecoder::decode(const void *aData, size_t aSize, const Handler &aHandler) {
+	return decodePacket((const uint8_t *)aData, aSize, 1, 0, aHandler);
+}
+
+bool VDOscDecoder::decodePacket(const uint8_t *aData, size_t aSize, uint64_t aTimetag, int aDepth, const Handler &aHandler) {
+	const uint8_t *end = aData + aSize;
+	if (aSize >= 16 && memcmp(aData, "#bundle", 8) == 0) {
+		if (aDepth >= 8) return false;
+		uint64_t timetag = readUint64(aData + 8);
+		const uint8_t *p = aData + 16;
+		while (p < end) {
+			if (end - p < 4) return false;
+			size_t size = readUint32(p);
+			p += 4;
+			if (size > (size_t)(end - p) || (size & 3) != 0) return false;
+			if (!decodePacket(p, size, timetag, aDepth + 1, aHandler)) return false;
+			p += size;
+		}
+		return true;
+	}
+	if (aSize < 4 || aData[0] != '/') return false;
+	VDOscMessage message;
+	size_t size = readString(aData, end, message.address);
+	if (size == 0) return false;
+	message.timetag = aTimetag;
+	const uint8_t *p = aData + size;
+	VDStringRef typeTags;
+	if (p < end && *p == ',') {
+		size_t tagsSize = readString(p, end, typeTags);
+		if (tagsSize == 0) return false;
+		p += tagsSize;
+		// skip the ','
+		message.mTypeTags = typeTags.data + 1;
+		message.mTypeTagsEnd = typeTags.data + typeTags.size;
+	}
+	message.mData = p;
+	message.mEnd = end;
+	aHandler(message);
+	return true;
+}
+
+bool VDOscDecoder::match(const VDStringRef &aPattern, const VDStringRef &aAddress) {
+	// the pattern comes from the peer: refuse what can't match or would take long to find out
+	size_t minSize;
+	int wildcards;
+	if (!inspectPattern(aPattern.data, aPattern.data + aPattern.size, minSize, wildcards)) return false;
+	if (minSize > aAddress.size || wildcards > kMaxWildcards) return false;
+	return matchFrom(aPattern.data, aPattern.data + aPattern.size, aAddress.data, aAddress.data + aAddress.size);
+}
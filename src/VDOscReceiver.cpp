@@ -0,0 +1,171 @@
+#include "VDOscReceiver.h"
+
+#include "cinder/Log.h"
+
+#if defined( __linux__ )
+	#include <sys/socket.h>
+	#include <cerrno>
+#endif
+
+using namespace ci;
+using namespace std;
+using namespace videodromm;
+
+VDOscReceiver::VDOscReceiver(asio::io_service &aIoService, const Handler &aHandler)
+	: mIoService(aIoService), mSocket(aIoService), mRetryTimer(aIoService), mRetryDelay(0), mHandler(aHandler), mOpen(false), mPort(0),
+	mBuffer(kBatchSize * kSlotSize), mPackets(0), mBytes(0), mBatches(0), mTruncated(0), mErrors(0) {
+}
+
+VDOscReceiver::~VDOscReceiver() {
+	asio::error_code err;
+	mRetryTimer.cancel(err);
+	mSocket.close(err);
+}
+
+bool VDOscReceiver::open(uint16_t aPort, const string &aAddress) {
+	if (mOpen) return false;
+	asio::error_code err;
+	asio::ip::address address = asio::ip::address::from_string(aAddress, err);
+	if (err) {
+		CI_LOG_W("VDOscReceiver invalid address " << aAddress);
+		return false;
+	}
+	asio::ip::udp::endpoint endpoint(address, aPort);
+	mSocket.open(endpoint.protocol(), err);
+	if (!err) mSocket.set_option(asio::ip::udp::socket::reuse_address(true), err);
+	if (!err) mSocket.bind(endpoint, err);
+	if (!err) mSocket.non_blocking(true, err);
+	if (err) {
+		CI_LOG_W("VDOscReceiver could not listen on port " << aPort << ": " << err.message());
+		mSocket.close(err);
+		return false;
+	}
+	// room for a burst from several controllers between two drains
+	mSocket.set_option(asio::socket_base::receive_buffer_size(1 << 20), err);
+	mPort = mSocket.local_endpoint(err).port();
+	mOpen = true;
+	// the socket is only touched on the io thread from now on
+	weak_ptr<VDOscReceiver> weak = shared_from_this();
+	if (mIoService.stopped()) mIoService.reset();
+	mIoService.post([weak]() {
+		if (auto receiver = weak.lock()) receiver->wait();
+	});
+	return true;
+}
+
+void VDOscReceiver::close() {
+	if (!mOpen) return;
+	mOpen = false;
+	// closed on the io thread, which keeps the receiver alive until then
+	VDOscReceiverRef self = shared_from_this();
+	if (mIoService.stopped()) mIoService.reset();
+	mIoService.post([self]() {
+		asio::error_code err;
+		self->mRetryTimer.cancel(err);
+		self->mSocket.close(err);
+	});
+}
+
+void VDOscReceiver::wait() {
+	if (!mOpen || !mSocket.is_open()) return;
+	// null_buffers only reports readability, drain() reads everything pending
+	weak_ptr<VDOscReceiver> weak = shared_from_this();
+	mSocket.async_receive(asio::null_buffers(), [weak](const asio::error_code &aError, size_t) {
+		if (aError) return;
+		if (auto receiver = weak.lock()) receiver->drain();
+	});
+}
+
+void VDOscReceiver::drain() {
+	asio::error_code err;
+	size_t count = receiveBatch(err);
+	if (count > 0) {
+		mBatches++;
+		mPackets += count;
+		size_t bytes = 0;
+		for (size_t i = 0; i < count; i++) bytes += mDatagrams[i].size;
+		mBytes += bytes;
+		mHandler(mDatagrams, count);
+	}
+	if (err) {
+		// an error that persists keeps the socket readable, waiting again right away would spin
+		mErrors++;
+		if (mRetryDelay == 0) CI_LOG_W("VDOscReceiver receive failed: " << err.message());
+		mRetryDelay = mRetryDelay == 0 ? kRetryMin : min(mRetryDelay * 2, kRetryMax);
+		weak_ptr<VDOscReceiver> weak = shared_from_this();
+		mRetryTimer.expires_from_now(chrono::milliseconds(mRetryDelay));
+		mRetryTimer.async_wait([weak](const asio::error_code &aError) {
+			if (aError) return;
+			if (auto receiver = weak.lock()) receiver->wait();
+		});
+		return;
+	}
+	mRetryDelay = 0;
+	// a full batch leaves the socket readable, the wait completes right away
+	wait();
+}
+
+size_t VDOscReceiver::receiveBatch(asio::error_code &aError) {
+	size_t count = 0;
+#if defined( __linux__ )
+	// one syscall for the whole batch
+	mmsghdr messages[kBatchSize];
+	iovec vectors[kBatchSize];
+	memset(messages, 0, sizeof(messages));
+	for (size_t i = 0; i < kBatchSize; i++) {
+		vectors[i].iov_base = &mBuffer[i * kSlotSize];
+		vectors[i].iov_len = kSlotSize;
+		messages[i].msg_hdr.msg_iov = &vectors[i];
+		messages[i].msg_hdr.msg_iovlen = 1;
+	}
+	int received = recvmmsg(mSocket.native_handle(), messages, (unsigned int)kBatchSize, MSG_DONTWAIT, nullptr);
+	// a pending icmp error is reported, and cleared, by the receive: not a reason to stop
+	if (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNREFUSED && errno != ECONNRESET) {
+		aError = asio::error_code(errno, asio::error::get_system_category());
+	}
+	for (int i = 0; i < received; i++) {
+		if (messages[i].msg_hdr.msg_flags & MSG_TRUNC) {
+			mTruncated++;
+			continue;
+		}
+		mDatagrams[count].data = &mBuffer[i * kSlotSize];
+		mDatagrams[count].size = messages[i].msg_len;
+		count++;
+	}
+#else
+	// non-blocking socket, read until it would block or the batch is full
+	for (size_t i = 0; i < kBatchSize; i++) {
+		asio::error_code err;
+		uint8_t *slot = &mBuffer[i * kSlotSize];
+		size_t size = mSocket.receive(asio::buffer(slot, kSlotSize), 0, err);
+		if (err == asio::error::would_block || err == asio::error::try_again) break;
+		if (err == asio::error::message_size) {
+			// winsock drops the rest of an oversized datagram
+			mTruncated++;
+			continue;
+		}
+		if (err == asio::error::connection_reset || err == asio::error::connection_refused) {
+			// WSAECONNRESET: an icmp port unreachable for something sent from this port, nothing was lost
+			continue;
+		}
+		if (err) {
+			aError = err;
+			break;
+		}
+		mDatagrams[count].data = slot;
+		mDatagrams[count].size = size;
+		count++;
+	}
+#endif
+	return count;
+}
+
+VDOscReceiverStats VDOscReceiver::getStats() const {
+	VDOscReceiverStats stats;
+	stats.packets = mPackets.load();
+	stats.bytes = mBytes.load();
+	stats.batches = mBatches.load();
+	stats.truncated = mTruncated.load();
+	stats.errors = mErrors.load();
+	return stats;
+}
@@ -0,0 +1,47 @@
+#include "VDOscRouter.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace videodromm;
+
+void VDOscRouter::addRoute(const string &aAddress, const Handler &aHandler) {
+	auto it = find_if(mRoutes.begin(), mRoutes.end(), [&](const Route &route) { return route.address == aAddress; });
+	if (it != mRoutes.end()) {
+		it->handler = aHandler;
+	}
+	else {
+		Route route;
+		route.address = aAddress;
+		route.handler = aHandler;
+		mRoutes.push_back(route);
+	}
+}
+
+void VDOscRouter::removeRoute(const string &aAddress) {
+	mRoutes.erase(remove_if(mRoutes.begin(), mRoutes.end(), [&](const Route &route) { return route.address == aAddress; }), mRoutes.end());
+}
+
+size_t VDOscRouter::dispatch(const VDOscMessage &aMessage) const {
+	const VDStringRef &address = aMessage.address;
+	bool isPattern = false;
+	for (size_t i = 0; i < address.size && !isPattern; i++) {
+		char c = address.data[i];
+		isPattern = c == '?' || c == '*' || c == '[' || c == '{';
+	}
+	size_t matched = 0;
+	for (const Route &route : mRoutes) {
+		if (isPattern) {
+			if (!VDOscDecoder::match(address, VDStringRef(route.address.data(), route.address.size()))) continue;
+		}
+		else if (route.address.size() != address.size || memcmp(route.address.data(), address.data, address.size) != 0) {
+			continue;
+		}
+		// every handler reads the arguments from the start
+		VDOscMessage message = aMessage;
+		route.handler(message);
+		matched++;
+	}
+	return matched;
+}
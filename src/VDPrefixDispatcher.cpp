@@ -0,0 +1,39 @@
+#include "VDPrefixDispatcher.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace videodromm;
+
+void VDPrefixDispatcher::addHandler(const string &aPrefix, const VDPrefixHandler &aHandler) {
+	if (aPrefix.empty()) return;
+	vector<Entry> &bucket = mBuckets[(uint8_t)aPrefix[0]];
+	auto it = find_if(bucket.begin(), bucket.end(), [&](const Entry &entry) { return entry.prefix == aPrefix; });
+	if (it != bucket.end()) {
+		it->handler = aHandler;
+	}
+	else {
+		Entry entry;
+		entry.prefix = aPrefix;
+		entry.handler = aHandler;
+		bucket.push_back(entry);
+		stable_sort(bucket.begin(), bucket.end(), [](const Entry &a, const Entry &b) { return a.prefix.size() > b.prefix.size(); });
+	}
+}
+
+void VDPrefixDispatcher::removeHandler(const string &aPrefix) {
+	if (aPrefix.empty()) return;
+	vector<Entry> &bucket = mBuckets[(uint8_t)aPrefix[0]];
+	bucket.erase(remove_if(bucket.begin(), bucket.end(), [&](const Entry &entry) { return entry.prefix == aPrefix; }), bucket.end());
+}
+
+bool VDPrefixDispatcher::dispatch(const VDStringRef &aMessage) const {
+	if (aMessage.empty()) return false;
+	for (const Entry &entry : mBuckets[(uint8_t)aMessage.data[0]]) {
+		if (aMessage.startsWith(entry.prefix.data(), entry.prefix.size())) {
+			entry.handler(aMessage);
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,130 @@
+#include "VDShaderArchive.h"
+
+#include "cinder/Log.h"
+
+#include <cstdio>
+#if defined( CINDER_MSW )
+	#include <io.h>
+#else
+	#include <unistd.h>
+#endif
+
+using namespace ci;
+using namespace std;
+using namespace videodromm;
+
+namespace {
+	// the title comes from the network, keep it inside the archive folder
+	string sanitizeFileName(const string &aFileName) {
+		string fileName = aFileName;
+		for (char &c : fileName) {
+			if (c == '/' || c == '\\' || c == ':' || c == '*' || c == '?' || c == '"' || c == '<' || c == '>' || c == '|' || (unsigned char)c < 32) c = '_';
+		}
+		if (fileName.empty() || fileName[0] == '.') fileName.insert(0, "_");
+		return fileName;
+	}
+
+	void syncFile(FILE *aFile) {
+		fflush(aFile);
+#if defined( CINDER_MSW )
+		_commit(_fileno(aFile));
+#else
+		fsync(fileno(aFile));
+#endif
+	}
+}
+
+const int VDShaderArchive::kBatchMilliseconds;
+
+VDShaderArchive::VDShaderArchive(const fs::path &aRoot)
+	: mRoot(aRoot), mRunning(true), mWritten(0), mDropped(0) {
+	mWriter = thread(&VDShaderArchive::writerLoop, this);
+}
+
+VDShaderArchive::~VDShaderArchive() {
+	{
+		lock_guard<mutex> lock(mMutex);
+		mRunning = false;
+	}
+	mCondition.notify_one();
+	// pending writes are flushed before the writer exits
+	if (mWriter.joinable()) mWriter.join();
+}
+
+void VDShaderArchive::write(Folder aFolder, const string &aFileName, const string &aContent) {
+	string fileName = sanitizeFileName(aFileName);
+	{
+		lock_guard<mutex> lock(mMutex);
+		for (Job &job : mPending) {
+			if (job.folder == aFolder && job.fileName == fileName) {
+				job.content = aContent;
+				return;
+			}
+		}
+		if (mPending.size() >= kMaxPending) {
+			mDropped++;
+			return;
+		}
+		Job job;
+		job.folder = aFolder;
+		job.fileName = fileName;
+		job.content = aContent;
+		mPending.push_back(std::move(job));
+	}
+	mCondition.notify_one();
+}
+
+void VDShaderArchive::writerLoop() {
+	// create folders if they don't exist, once
+	bool ready = false;
+	try {
+		fs::create_directories(mRoot / "received");
+		fs::create_directories(mRoot / "processed");
+		ready = true;
+	}
+	catch (const std::exception &e) {
+		CI_LOG_E("VDShaderArchive can't create " << mRoot.string() << ": " << e.what());
+	}
+	deque<Job> batch;
+	while (true) {
+		{
+			unique_lock<mutex> lock(mMutex);
+			mCondition.wait(lock, [this] { return !mRunning || !mPending.empty(); });
+			if (mRunning) {
+				// let a burst of edits pile up, rewrites of a file collapse in the queue
+				mCondition.wait_for(lock, chrono::milliseconds(kBatchMilliseconds), [this] { return !mRunning; });
+			}
+			batch.swap(mPending);
+			if (batch.empty() && !mRunning) return;
+		}
+		if (ready) {
+			writeBatch(batch);
+		}
+		else {
+			mDropped += batch.size();
+		}
+		batch.clear();
+	}
+}
+
+void VDShaderArchive::writeBatch(deque<Job> &aBatch) {
+	vector<FILE *> files;
+	for (const Job &job : aBatch) {
+		fs::path path = mRoot / (job.folder == RECEIVED ? "received" : "processed") / job.fileName;
+		FILE *file = fopen(path.string().c_str(), "wb");
+		if (!file) {
+			CI_LOG_W("VDShaderArchive can't write " << path.string());
+			mDropped++;
+			continue;
+		}
+		fwrite(job.content.data(), 1, job.content.size(), file);
+		files.push_back(file);
+	}
+	// one sync pass for the whole batch
+	for (FILE *file : files) {
+		syncFile(file);
+		if (ferror(file)) mDropped++;
+		else mWritten++;
+		fclose(file);
+	}
+}
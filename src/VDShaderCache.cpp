@@ -0,0 +1,98 @@
+#include "VDShaderCache.h"
+
+using namespace ci;
+using namespace std;
+using namespace videodromm;
+
+VDShaderCache::VDShaderCache(size_t aCapacity)
+	: mCapacity(aCapacity > 0 ? aCapacity : 1), mRepeats(0), mHits(0), mMisses(0) {
+}
+
+VDShaderCache::History::History() {
+	for (int i = 0; i < KIND_COUNT; i++) {
+		hash[i] = 0;
+		size[i] = 0;
+	}
+}
+
+uint64_t VDShaderCache::hash(const char *aData, size_t aSize) {
+	const uint64_t m = 0xc6a4a7935bd1e995ULL;
+	const int r = 47;
+	uint64_t h = 0x8445d61a4e774912ULL ^ (aSize * m);
+	const uint8_t *data = (const uint8_t *)aData;
+	const uint8_t *end = data + (aSize & ~(size_t)7);
+	while (data != end) {
+		uint64_t k;
+		memcpy(&k, data, 8);
+		data += 8;
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+		h ^= k;
+		h *= m;
+	}
+	switch (aSize & 7) {
+	case 7: h ^= (uint64_t)data[6] << 48;
+	case 6: h ^= (uint64_t)data[5] << 40;
+	case 5: h ^= (uint64_t)data[4] << 32;
+	case 4: h ^= (uint64_t)data[3] << 24;
+	case 3: h ^= (uint64_t)data[2] << 16;
+	case 2: h ^= (uint64_t)data[1] << 8;
+	case 1: h ^= (uint64_t)data[0];
+		h *= m;
+	}
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+	return h;
+}
+
+bool VDShaderCache::isRepeat(History &aHistory, Kind aKind, uint64_t aHash, size_t aSize) {
+	if (aHistory.size[aKind] == aSize && aHistory.hash[aKind] == aHash) {
+		mRepeats++;
+		return true;
+	}
+	aHistory.hash[aKind] = aHash;
+	aHistory.size[aKind] = aSize;
+	return false;
+}
+
+void VDShaderCache::forgetLast(History &aHistory, Kind aKind) {
+	aHistory.hash[aKind] = 0;
+	aHistory.size[aKind] = 0;
+}
+
+VDProcessedShaderRef VDShaderCache::find(Kind aKind, uint64_t aHash) {
+	auto it = mIndex.find(key(aKind, aHash));
+	if (it == mIndex.end()) {
+		mMisses++;
+		return nullptr;
+	}
+	mHits++;
+	mEntries.splice(mEntries.begin(), mEntries, it->second);
+	return it->second->second;
+}
+
+void VDShaderCache::insert(Kind aKind, uint64_t aHash, const VDProcessedShaderRef &aShader) {
+	uint64_t k = key(aKind, aHash);
+	auto it = mIndex.find(k);
+	if (it != mIndex.end()) {
+		it->second->second = aShader;
+		mEntries.splice(mEntries.begin(), mEntries, it->second);
+		return;
+	}
+	mEntries.push_front(make_pair(k, aShader));
+	mIndex[k] = mEntries.begin();
+	if (mEntries.size() > mCapacity) {
+		mIndex.erase(mEntries.back().first);
+		mEntries.pop_back();
+	}
+}
+
+VDShaderCacheStats VDShaderCache::getStats() const {
+	VDShaderCacheStats stats;
+	stats.repeats = mRepeats.load();
+	stats.hits = mHits.load();
+	stats.misses = mMisses.load();
+	return stats;
+}
@@ -0,0 +1,70 @@
+#include "VDShaderPatcher.h"
+
+#include <cstring>
+
+using namespace ci;
+using namespace std;
+using namespace videodromm;
+
+VDShaderPatcher::VDShaderPatcher()
+	: mApplied(0), mRejected(0), mPatchBytes(0), mTextBytes(0) {
+	for (int i = 0; i < VDShaderCache::KIND_COUNT; i++) mVersion[i] = 0;
+}
+
+void VDShaderPatcher::setText(VDShaderCache::Kind aKind, int aVersion, const string &aText) {
+	mText[aKind] = aText;
+	mVersion[aKind] = aVersion;
+}
+
+bool VDShaderPatcher::apply(VDShaderCache::Kind aKind, int aBase, int aVersion, const VDStringRef &aSplices) {
+	if (mVersion[aKind] == 0 || aBase != mVersion[aKind]) {
+		mRejected++;
+		return false;
+	}
+	VDJsonReader reader(aSplices);
+	mScratch = mText[aKind];
+	bool ok = reader.beginArray();
+	while (ok && reader.nextElement()) ok = splice(mScratch, reader);
+	if (!ok || reader.failed()) {
+		// the sender is past aBase now, wait for its full resend
+		mVersion[aKind] = 0;
+		mRejected++;
+		return false;
+	}
+	string &text = mText[aKind];
+	text.swap(mScratch);
+	mVersion[aKind] = aVersion;
+	mApplied++;
+	mPatchBytes += aSplices.size;
+	mTextBytes += text.size();
+	return true;
+}
+
+bool VDShaderPatcher::splice(string &aText, VDJsonReader &aReader) {
+	// [offset, erase, "insert"]
+	int offset, erase;
+	VDStringRef insert;
+	if (!aReader.beginArray()) return false;
+	if (!aReader.nextElement() || !aReader.readInt(offset)) return false;
+	if (!aReader.nextElement() || !aReader.readInt(erase)) return false;
+	if (!aReader.nextElement() || !aReader.readString(insert)) return false;
+	if (aReader.nextElement()) return false;
+	if (offset < 0 || erase < 0 || (size_t)offset + erase > aText.size()) return false;
+	if (memchr(insert.data, '\\', insert.size)) {
+		VDJsonReader::unescape(insert, mInsert);
+		aText.replace(offset, erase, mInsert);
+	}
+	else {
+		aText.replace(offset, erase, insert.data, insert.size);
+	}
+	return true;
+}
+
+VDShaderPatchStats VDShaderPatcher::getStats() const {
+	VDShaderPatchStats stats;
+	stats.applied = mApplied.load();
+	stats.rejected = mRejected.load();
+	stats.patchBytes = mPatchBytes.load();
+	stats.textBytes = mTextBytes.load();
+	return stats;
+}
@@ -0,0 +1,54 @@
+#include "VDTrafficRecorder.h"
+
+#include "cinder/Log.h"
+
+using namespace ci;
+using namespace std;
+using namespace videodromm;
+
+VDTrafficRecorder::VDTrafficRecorder(const fs::path &aPath)
+	: mUsed(0), mMessageCount(0), mStart(chrono::steady_clock::now()) {
+	if (!mFile.openWrite(aPath, kGrowSize)) {
+		CI_LOG_E("VDTrafficRecorder could not open " << aPath.string());
+		return;
+	}
+	uint8_t *data = mFile.getData();
+	memcpy(data, "HYDT", 4);
+	uint32_t version = VDTrafficCapture::kVersion;
+	memcpy(data + 4, &version, 4);
+	mUsed = VDTrafficCapture::kHeaderSize;
+	uint64_t used = mUsed;
+	memcpy(data + 8, &used, 8);
+}
+
+VDTrafficRecorder::~VDTrafficRecorder() {
+	lock_guard<mutex> lock(mMutex);
+	// drop the reserved tail
+	if (mFile.isOpen()) mFile.close(mUsed);
+}
+
+void VDTrafficRecorder::record(uint8_t aOpcode, uint8_t aSource, const void *aData, size_t aSize) {
+	uint64_t timestamp = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - mStart).count();
+	lock_guard<mutex> lock(mMutex);
+	if (!mFile.isOpen() || aSize > 0xFFFFFFFF) return;
+	size_t needed = mUsed + VDTrafficCapture::kRecordHeaderSize + aSize;
+	if (needed > mFile.getSize()) {
+		if (!mFile.resize(max(needed, mFile.getSize() + kGrowSize))) {
+			CI_LOG_E("VDTrafficRecorder could not grow the capture, recording stopped");
+			return;
+		}
+	}
+	uint8_t *record = mFile.getData() + mUsed;
+	uint32_t size = (uint32_t)aSize;
+	memcpy(record, &timestamp, 8);
+	memcpy(record + 8, &size, 4);
+	record[12] = aOpcode;
+	record[13] = aSource;
+	record[14] = record[15] = 0;
+	memcpy(record + VDTrafficCapture::kRecordHeaderSize, aData, aSize);
+	mUsed = needed;
+	mMessageCount++;
+	// commit the record
+	uint64_t used = mUsed;
+	memcpy(mFile.getData() + 8, &used, 8);
+}
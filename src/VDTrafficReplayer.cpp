@@ -0,0 +1,74 @@
+#include "VDTrafficReplayer.h"
+
+#include "cinder/Log.h"
+
+#include <chrono>
+#include <thread>
+
+using namespace ci;
+using namespace std;
+using namespace videodromm;
+
+VDTrafficReplayer::VDTrafficReplayer(const fs::path &aPath)
+	: mUsed(0), mMessageCount(0), mDuration(0) {
+	if (!mFile.openRead(aPath)) {
+		CI_LOG_E("VDTrafficReplayer could not open " << aPath.string());
+		return;
+	}
+	const uint8_t *data = mFile.getData();
+	uint32_t version = 0;
+	uint64_t used = 0;
+	if (mFile.getSize() >= VDTrafficCapture::kHeaderSize) {
+		memcpy(&version, data + 4, 4);
+		memcpy(&used, data + 8, 8);
+	}
+	if (mFile.getSize() < VDTrafficCapture::kHeaderSize || memcmp(data, "HYDT", 4) != 0 || version != VDTrafficCapture::kVersion || used > mFile.getSize()) {
+		CI_LOG_E("VDTrafficReplayer " << aPath.string() << " is not a capture");
+		mFile.close();
+		return;
+	}
+	// count the complete records, a truncated last one is ignored
+	size_t offset = VDTrafficCapture::kHeaderSize;
+	while (offset + VDTrafficCapture::kRecordHeaderSize <= used) {
+		uint64_t timestamp;
+		uint32_t size;
+		memcpy(&timestamp, data + offset, 8);
+		memcpy(&size, data + offset + 8, 4);
+		size_t next = offset + VDTrafficCapture::kRecordHeaderSize + size;
+		if (next > used) break;
+		mDuration = timestamp;
+		mMessageCount++;
+		offset = next;
+	}
+	mUsed = offset;
+}
+
+uint64_t VDTrafficReplayer::replay(float aSpeed, const Handler &aHandler, const atomic<bool> &aCancel) {
+	if (!isOpen()) return 0;
+	const uint8_t *data = mFile.getData();
+	auto start = chrono::steady_clock::now();
+	uint64_t first = 0;
+	uint64_t delivered = 0;
+	size_t offset = VDTrafficCapture::kHeaderSize;
+	while (offset < mUsed && !aCancel) {
+		uint64_t timestamp;
+		uint32_t size;
+		memcpy(&timestamp, data + offset, 8);
+		memcpy(&size, data + offset + 8, 4);
+		uint8_t opcode = data[offset + 12];
+		uint8_t source = data[offset + 13];
+		if (delivered == 0) first = timestamp;
+		if (aSpeed > 0.0f) {
+			auto due = start + chrono::microseconds((int64_t)((timestamp - first) / aSpeed));
+			// sleep in slices so a long silence in the capture can still be cancelled
+			while (!aCancel && chrono::steady_clock::now() < due) {
+				this_thread::sleep_until(min(due, chrono::steady_clock::now() + chrono::milliseconds(50)));
+			}
+			if (aCancel) break;
+		}
+		aHandler(opcode, source, data + offset + VDTrafficCapture::kRecordHeaderSize, size);
+		delivered++;
+		offset += VDTrafficCapture::kRecordHeaderSize + size;
+	}
+	return delivered;
+}
@@ -0,0 +1,176 @@
+#include "VDUniformBlock.h"
+
+#include "VDShaderCache.h"
+
+#include <cstring>
+#include <sstream>
+
+using namespace ci;
+using namespace std;
+using namespace videodromm;
+
+namespace {
+	// glsl identifiers only, the names end up in a block declaration
+	bool isIdentifier(const VDStringRef &aName) {
+		if (aName.empty() || (aName.data[0] >= '0' && aName.data[0] <= '9')) return false;
+		for (size_t i = 0; i < aName.size; i++) {
+			char c = aName.data[i];
+			if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_')) return false;
+		}
+		return true;
+	}
+
+	const char * getTypeName(VDUniformBlock::Type aType) {
+		switch (aType) {
+		case VDUniformBlock::VEC2: return "vec2";
+		case VDUniformBlock::VEC3: return "vec3";
+		case VDUniformBlock::VEC4: return "vec4";
+		default: return "float";
+		}
+	}
+
+	// std140: floats align to 4, vec2 to 8, vec3 and vec4 to 16
+	uint32_t getAlignment(VDUniformBlock::Type aType) {
+		switch (aType) {
+		case VDUniformBlock::FLOAT: return 4;
+		case VDUniformBlock::VEC2: return 8;
+		default: return 16;
+		}
+	}
+}
+
+VDUniformBlock::VDUniformBlock()
+	: mVersion(0), mInPlaceUpdates(0), mLayoutChanges(0) {
+}
+
+bool VDUniformBlock::readValue(VDJsonReader &aReader, float *aValues, int &aCount) {
+	aCount = 0;
+	char c = aReader.peek();
+	if (c == 't' || c == 'f') {
+		aValues[0] = c == 't' ? 1.0f : 0.0f;
+		aCount = 1;
+		return aReader.skipValue();
+	}
+	if (c == '[') {
+		if (!aReader.beginArray()) return false;
+		while (aReader.nextElement()) {
+			if (aCount < 4 && aReader.peek() != '[' && aReader.peek() != '{') {
+				if (!aReader.readFloat(aValues[aCount])) return false;
+			}
+			else if (!aReader.skipValue()) {
+				return false;
+			}
+			aCount++;
+		}
+		if (aCount < 2 || aCount > 4) aCount = 0;
+		return aCount > 0;
+	}
+	if (c == '-' || (c >= '0' && c <= '9')) {
+		aCount = 1;
+		return aReader.readFloat(aValues[0]);
+	}
+	aReader.skipValue();
+	return false;
+}
+
+bool VDUniformBlock::fill(const VDStringRef &aJson, const Layout &aLayout) {
+	VDJsonReader reader(aJson);
+	if (!reader.beginObject()) return false;
+	VDStringRef key;
+	float values[4];
+	int count;
+	size_t index = 0;
+	while (reader.nextKey(key)) {
+		if (!readValue(reader, values, count) || !isIdentifier(key)) {
+			if (reader.failed()) return false;
+			continue;
+		}
+		// same position, same name, same type, or the shape changed
+		if (index >= aLayout.entries.size()) return false;
+		const Entry &entry = aLayout.entries[index++];
+		if (entry.type != count || entry.name.size() != key.size || memcmp(entry.name.data(), key.data, key.size) != 0) return false;
+		memcpy(mData.data() + entry.offset, values, count * sizeof(float));
+	}
+	return !reader.failed() && index == aLayout.entries.size();
+}
+
+VDUniformBlock::LayoutRef VDUniformBlock::buildLayout(const VDStringRef &aJson) {
+	VDJsonReader reader(aJson);
+	if (!reader.beginObject()) return nullptr;
+	Layout *layout = new Layout();
+	LayoutRef result(layout);
+	string signature;
+	VDStringRef key;
+	float values[4];
+	int count;
+	uint32_t offset = 0;
+	while (reader.nextKey(key)) {
+		if (!readValue(reader, values, count) || !isIdentifier(key)) {
+			if (reader.failed()) return nullptr;
+			continue;
+		}
+		Entry entry;
+		entry.name = key.str();
+		entry.type = (Type)count;
+		uint32_t alignment = getAlignment(entry.type);
+		entry.offset = (offset + alignment - 1) & ~(alignment - 1);
+		offset = entry.offset + count * sizeof(float);
+		layout->entries.push_back(entry);
+		signature += entry.name;
+		signature += (char)('0' + count);
+	}
+	if (reader.failed()) return nullptr;
+	// a uniform block is padded to a vec4
+	layout->size = (offset + 15) & ~15;
+	layout->hash = VDShaderCache::hash(signature.data(), signature.size());
+	// the same shape as before, reuse its layout
+	auto it = mLayouts.find(layout->hash);
+	if (it != mLayouts.end() && it->second->entries.size() == layout->entries.size()) return it->second;
+	if (mLayouts.size() >= kMaxLayouts) mLayouts.clear();
+	mLayouts[layout->hash] = result;
+	return result;
+}
+
+bool VDUniformBlock::update(const VDStringRef &aJson) {
+	if (mLayout && fill(aJson, *mLayout)) {
+		mInPlaceUpdates++;
+		mVersion++;
+		return true;
+	}
+	LayoutRef layout = buildLayout(aJson);
+	if (!layout) return false;
+	mLayout = layout;
+	mData.assign(layout->size, 0);
+	if (!fill(aJson, *layout)) return false;
+	mLayoutChanges++;
+	mVersion++;
+	return true;
+}
+
+const vector<VDUniformBlock::Entry> & VDUniformBlock::getEntries() const {
+	static const vector<Entry> empty;
+	return mLayout ? mLayout->entries : empty;
+}
+
+const VDUniformBlock::Entry * VDUniformBlock::find(const string &aName) const {
+	if (!mLayout) return nullptr;
+	for (const Entry &entry : mLayout->entries) {
+		if (entry.name == aName) return &entry;
+	}
+	return nullptr;
+}
+
+float VDUniformBlock::getFloat(const Entry &aEntry, int aComponent) const {
+	if (aComponent < 0 || aComponent >= aEntry.type) return 0.0f;
+	float value;
+	memcpy(&value, mData.data() + aEntry.offset + aComponent * sizeof(float), sizeof(float));
+	return value;
+}
+
+string VDUniformBlock::getDeclaration(const string &aName) const {
+	stringstream ss;
+	ss << "layout(std140) uniform " << aName << " {\n";
+	for (const Entry &entry : getEntries()) ss << "\t" << getTypeName(entry.type) << " " << entry.name << ";\n";
+	ss << "};\n";
+	return ss.str();
+}
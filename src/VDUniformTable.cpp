@@ -0,0 +1,64 @@
+#include "VDUniformTable.h"
+
+#include <cstring>
+
+using namespace ci;
+using namespace std;
+using namespace videodromm;
+
+VDUniformTable::VDUniformTable()
+	: mVersion(0), mReceiveTime(0), mUnconsumedReceived(0), mWriteIndex(0), mReadIndex(1), mMiddle(2), mConsumedVersion(0) {
+	memset(mWorking.floats, 0, sizeof(mWorking.floats));
+	for (size_t i = 0; i < VDUniformSnapshot::kSize; i++) mWorking.vec4s[i] = vec4(0.0f);
+	mWorking.version = 0;
+	mWorking.received = 0;
+	for (auto &buffer : mBuffers) buffer = mWorking;
+}
+
+void VDUniformTable::setFloat(unsigned int aIndex, float aValue) {
+	if (aIndex >= VDUniformSnapshot::kSize) return;
+	mWorking.floats[aIndex] = aValue;
+	mWorking.floatDirty.set(aIndex);
+	if (mWorking.received == 0) mWorking.received = mReceiveTime;
+}
+
+void VDUniformTable::setVec4(unsigned int aIndex, const vec4 &aValue) {
+	if (aIndex >= VDUniformSnapshot::kSize) return;
+	mWorking.vec4s[aIndex] = aValue;
+	mWorking.vec4Dirty.set(aIndex);
+	if (mWorking.received == 0) mWorking.received = mReceiveTime;
+}
+
+void VDUniformTable::publish() {
+	if (mWorking.floatDirty.none() && mWorking.vec4Dirty.none()) return;
+	// the last published snapshot was picked up, its dirty lanes have been uploaded.
+	// otherwise it is about to be replaced and its dirty lanes carry over.
+	if (mConsumedVersion.load(memory_order_acquire) == mVersion) {
+		mUnconsumedFloat.reset();
+		mUnconsumedVec4.reset();
+		mUnconsumedReceived = 0;
+	}
+	if (mUnconsumedReceived == 0) mUnconsumedReceived = mWorking.received;
+	mUnconsumedFloat |= mWorking.floatDirty;
+	mUnconsumedVec4 |= mWorking.vec4Dirty;
+
+	VDUniformSnapshot &back = mBuffers[mWriteIndex];
+	memcpy(back.floats, mWorking.floats, sizeof(back.floats));
+	memcpy(back.vec4s, mWorking.vec4s, sizeof(back.vec4s));
+	back.floatDirty = mUnconsumedFloat;
+	back.vec4Dirty = mUnconsumedVec4;
+	back.received = mUnconsumedReceived;
+	back.version = ++mVersion;
+	mWorking.floatDirty.reset();
+	mWorking.vec4Dirty.reset();
+	mWorking.received = 0;
+
+	mWriteIndex = mMiddle.exchange(mWriteIndex | kFresh, memory_order_acq_rel) & kIndexMask;
+}
+
+bool VDUniformTable::swap() {
+	if ((mMiddle.load(memory_order_relaxed) & kFresh) == 0) return false;
+	mReadIndex = mMiddle.exchange(mReadIndex, memory_order_acq_rel) & kIndexMask;
+	mConsumedVersion.store(mBuffers[mReadIndex].version, memory_order_release);
+	return true;
+}
@@ -1,284 +1,880 @@
 #include "VDWebsocket.h"
 
+#include "cinder/Log.h"
+
 using namespace videodromm;
 
-VDWebsocket::VDWebsocket() {
+VDWebsocket::VDWebsocket()
+	: mNetworkThreaded(false), mInbox(256), mInboxDropped(0),
+	mReplaying(false), mReplayCancel(false), mReplayedMessages(0), mResumeNetworkThread(false) {
 
 	shaderReceived = false;
 	receivedFragString = "";
 	shaderUniforms = false;
 	receivedUniformsString = "";
-	streamReceived = false;
-	// WebSockets
-	clientConnected = false;
+	mShaderCache = VDShaderCache::create();
+	mShaderArchive = VDShaderArchive::create(getAssetPath("") / "glsl");
+	mUnhandledMessages = 0;
+	mLatency = VDLatencyTracker::create();
+	mMetricsTime = 0.0;
+	mMessageReceived = 0;
+	mMessageSenderTime = 0;
+	mMessageType = VDLatencyTracker::OTHER;
+	for (auto &pending : mPresentPending) pending = 0;
+	mShaderReceived = 0;
+	mHydraReceived = 0;
+	mEvent.received = 0;
+	addDefaultHandlers();
+	// WebSockets, source 0 is the default router
+	mSources.push_back(VDWebsocketSourceRef(new VDWebsocketSource()));
+	VDWebsocketSource &source = *mSources.back();
+	source.id = 0;
+	source.client.reset(new WebSocketClient(&mIoService));
+	source.connection = VDConnectionManager::create(*source.client);
+	source.connected = false;
+	source.canvasDecoder = VDCanvasDecoder::create();
+	source.uniforms = VDUniformTable::create();
+	source.uniformsChanged = false;
+	mCurrentSource = &source;
 
 	wsConnect();
 	mPingTime = getElapsedSeconds();
 
 }
 
-void VDWebsocket::updateParams(int iarg0, float farg1) {
-
-	if (iarg0 > 0 && iarg0 < 9) {
-		// sliders 
-		//mVDAnimation->setFloatUniformValueByIndex(iarg0, farg1);
+VDWebsocket::~VDWebsocket() {
+	stopReplay();
+	stopNetworkThread();
+	// nothing runs mIoService anymore, close the acceptor before the server goes
+	if (isMetricsServing()) mMetricsServer->cancel();
+	mMetricsServer.reset();
+	// clients close their connection after the connection manager is gone
+	for (auto &source : mSources) {
+		source->client->disconnectOpenEventHandler();
+		source->client->disconnectCloseEventHandler();
+		source->client->disconnectFailEventHandler();
 	}
-	if (iarg0 > 10 && iarg0 < 19) {
-		// rotary 
-		//mVDAnimation->setFloatUniformValueByIndex(iarg0, farg1);
-		//		wsWrite("{\"params\" :[{\"name\":" + toString(iarg0) + ",\"value\":" + toString(mVDAnimation->getFloatUniformValueByIndex(iarg0)) + "}]}");
+}
+
+unsigned int VDWebsocket::addSource(const vector<string> &aEndpoints) {
+	VDWebsocketSourceRef source(new VDWebsocketSource());
+	source->id = (unsigned int)mSources.size();
+	// one more connection on the shared io_service, no extra polling
+	source->client.reset(new WebSocketClient(&mIoService));
+	source->connection = VDConnectionManager::create(*source->client);
+	source->connection->setEndpoints(aEndpoints);
+	source->connected = false;
+	source->canvasDecoder = VDCanvasDecoder::create();
+	source->uniforms = VDUniformTable::create();
+	source->uniformsChanged = false;
+	mSources.push_back(source);
+	connectSource(*source);
+	return source->id;
+}
+
+void VDWebsocket::startNetworkThread() {
+	if (mNetworkThreaded) return;
+	mNetworkThreaded = true;
+	// keep run() alive while there is no connection
+	if (mIoService.stopped()) mIoService.reset();
+	mIoWork.reset(new asio::io_service::work(mIoService));
+	mNetworkThread = std::thread([this]() {
+		mIoService.run();
+	});
+}
+
+void VDWebsocket::stopNetworkThread() {
+	if (!mNetworkThreaded) return;
+	mIoWork.reset();
+	mIoService.stop();
+	if (mNetworkThread.joinable()) mNetworkThread.join();
+	mNetworkThreaded = false;
+	// allow polling again
+	mIoService.reset();
+}
 
+bool VDWebsocket::startRecording(const fs::path &aPath) {
+	VDTrafficRecorderRef recorder = VDTrafficRecorder::create(aPath);
+	if (!recorder->isOpen()) return false;
+	std::atomic_store(&mRecorder, recorder);
+	return true;
+}
+
+void VDWebsocket::stopRecording() {
+	// the file is closed once the message handler lets go of it
+	std::atomic_store(&mRecorder, VDTrafficRecorderRef());
+}
+
+bool VDWebsocket::startReplay(const fs::path &aPath, float aSpeed) {
+	stopReplay();
+	VDTrafficReplayerRef replayer = VDTrafficReplayer::create(aPath);
+	if (!replayer->isOpen()) return false;
+	// the replay thread becomes the only one parsing
+	mResumeNetworkThread = mNetworkThreaded;
+	stopNetworkThread();
+	mReplayCancel = false;
+	mReplayedMessages = 0;
+	mReplaying = true;
+	mReplayThread = std::thread([this, replayer, aSpeed]() {
+		replayer->replay(aSpeed, [this](uint8_t aOpcode, uint8_t aSource, const void *aData, size_t aSize) {
+			replayMessage(aOpcode, aSource, aData, aSize);
+		}, mReplayCancel);
+		mReplaying = false;
+	});
+	return true;
+}
+
+void VDWebsocket::replayMessage(uint8_t aOpcode, uint8_t aSource, const void *aData, size_t aSize) {
+	beginMessage(mSources[aSource < mSources.size() ? aSource : 0].get(), VDLatencyTracker::now());
+	if (aOpcode == VDTrafficCapture::BINARY) {
+		parseBinary(aData, aSize);
 	}
+	else {
+		parseMessage(VDStringRef((const char *)aData, aSize));
+	}
+	endMessage();
+	// update() does not publish while replaying. binary messages can be osc (udp datagrams are
+	// recorded as binary), publish() returns right away when the message changed nothing
+	publishUniforms(*mCurrentSource);
+	mReplayedMessages++;
+}
 
-	if (iarg0 > 40 && iarg0 < 49) {
-		// low row 
-		//mVDAnimation->setFloatUniformValueByIndex(iarg0, farg1);
+VDReplayTiming VDWebsocket::timeReplay(const fs::path &aPath, int aPasses) {
+	VDReplayTiming timing = {};
+	stopReplay();
+	VDTrafficReplayerRef replayer = VDTrafficReplayer::create(aPath);
+	if (!replayer->isOpen()) return timing;
+	// this thread becomes the only one parsing, events go through the inbox like during a replay
+	bool threaded = mNetworkThreaded;
+	stopNetworkThread();
+	mReplaying = true;
+	std::atomic<bool> cancel(false);
+	VDWebsocketEvent event;
+	for (int pass = 0; pass < aPasses; pass++) {
+		replayer->replay(0.0f, [&](uint8_t aOpcode, uint8_t aSource, const void *aData, size_t aSize) {
+			auto start = std::chrono::steady_clock::now();
+			replayMessage(aOpcode, aSource, aData, aSize);
+			while (mInbox.pop(event)) applyEvent(event);
+			auto elapsed = std::chrono::steady_clock::now() - start;
+			VDReplayTiming::Kind kind = aOpcode == VDTrafficCapture::BINARY ? VDReplayTiming::BINARY
+				: aSize > 0 && *(const char *)aData == '{' ? VDReplayTiming::JSON : VDReplayTiming::TEXT;
+			timing.messages[kind]++;
+			timing.bytes[kind] += aSize;
+			timing.nanos[kind] += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+		}, cancel);
 	}
+	mReplaying = false;
+	if (threaded) startNetworkThread();
+	return timing;
 }
 
-void VDWebsocket::wsPing() {
-#if defined( CINDER_MSW )
-	if (clientConnected) {
+void VDWebsocket::stopReplay() {
+	mReplayCancel = true;
+	joinReplay();
+}
 
-		mClient.ping();
+void VDWebsocket::joinReplay() {
+	if (!mReplayThread.joinable()) return;
+	mReplayThread.join();
+	if (mResumeNetworkThread) startNetworkThread();
+	mResumeNetworkThread = false;
+}
 
+void VDWebsocket::deliverEvent(VDWebsocketEvent &aEvent) {
+	if (mNetworkThreaded || mReplaying) {
+		if (!mInbox.push(std::move(aEvent))) mInboxDropped++;
+	}
+	else {
+		applyEvent(aEvent);
 	}
-#endif
 }
-string * VDWebsocket::getBase64Image() {
-	streamReceived = false;
-	return &mBase64String;
+
+void VDWebsocket::applyEvent(VDWebsocketEvent &aEvent) {
+	// swap so the previous buffer gets reused for the next event
+	switch (aEvent.type) {
+	case VDWebsocketEvent::SHADER:
+		receivedFragString.swap(aEvent.payload);
+		shaderReceived = true;
+		mShaderReceived = aEvent.received;
+		break;
+	case VDWebsocketEvent::UNIFORMS:
+		receivedUniformsString.swap(aEvent.payload);
+		shaderUniforms = true;
+		// same names and types as last time: values are written in place
+		mHydraBlock.update(VDStringRef(receivedUniformsString.data(), receivedUniformsString.size()));
+		mHydraReceived = aEvent.received;
+		break;
+	}
 }
-//dreads(1, 0, 0.8).out(o0)
-void VDWebsocket::parseMessage(string msg) {
-
-	if (!msg.empty()) {
-
-		string first = msg.substr(0, 1);
-		if (first == "{") {
-			// json
-			JsonTree json;
-			try {
-				json = JsonTree(msg);
-				// web controller
-				if (json.hasChild("params")) {
-					JsonTree jsonParams = json.getChild("params");
-					for (JsonTree::ConstIter jsonElement = jsonParams.begin(); jsonElement != jsonParams.end(); ++jsonElement) {
-						int name = jsonElement->getChild("name").getValue<int>();
-						float value = jsonElement->getChild("value").getValue<float>();
-						// basic name value 
-						//mVDAnimation->setFloatUniformValueByIndex(name, value);
-
-					}
-				}
 
-				if (json.hasChild("k2")) {
-					JsonTree jsonParams = json.getChild("k2");
-					for (JsonTree::ConstIter jsonElement = jsonParams.begin(); jsonElement != jsonParams.end(); ++jsonElement) {
-						int name = jsonElement->getChild("name").getValue<int>();
-						string value = jsonElement->getChild("value").getValue();
-						vector<string> vs = split(value, ",");
-						vec4 v = vec4(strtof((vs[0]).c_str(), 0), strtof((vs[1]).c_str(), 0), strtof((vs[2]).c_str(), 0), strtof((vs[3]).c_str(), 0));
-						// basic name value 
-						//mVDAnimation->setVec4UniformValueByIndex(name, v);
-					}
-				}
+void VDWebsocket::updateParams(int iarg0, float farg1) {
+	// sliders 1-8, rotary 11-18, low row 41-48 and any other index
+	// collapse into one upload per frame, see update()
+	if (iarg0 < 0) return;
+	VDJitterBufferRef jitter = std::atomic_load(&mCurrentSource->jitter);
+	if (jitter) jitter->pushFloat(iarg0, farg1, mMessageReceived, mMessageSenderTime);
+	else mCurrentSource->uniforms->setFloat(iarg0, farg1);
+}
+void VDWebsocket::setVec4Uniform(unsigned int aIndex, const vec4 &aValue) {
+	VDJitterBufferRef jitter = std::atomic_load(&mCurrentSource->jitter);
+	if (jitter) jitter->pushVec4(aIndex, aValue, mMessageReceived, mMessageSenderTime);
+	else mCurrentSource->uniforms->setVec4(aIndex, aValue);
+}
+void VDWebsocket::publishUniforms(VDWebsocketSource &aSource) {
+	if (!std::atomic_load(&aSource.jitter)) aSource.uniforms->publish();
+}
+bool VDWebsocket::setJitterDelay(double aSeconds, unsigned int aSource) {
+	if (mReplaying) return false;
+	VDWebsocketSource &source = *mSources[aSource < mSources.size() ? aSource : 0];
+	VDJitterBufferRef jitter = std::atomic_load(&source.jitter);
+	if (jitter && aSeconds > 0.0) {
+		jitter->setDelay(aSeconds);
+		return true;
+	}
+	if (!jitter && aSeconds <= 0.0) return true;
+	// the uniform table changes writer, nothing may be parsing meanwhile
+	bool threaded = mNetworkThreaded;
+	stopNetworkThread();
+	std::atomic_store(&source.jitter, aSeconds > 0.0 ? VDJitterBuffer::create(aSeconds) : VDJitterBufferRef());
+	if (threaded) startNetworkThread();
+	return true;
+}
+VDJitterStats VDWebsocket::getJitterStats(unsigned int aSource) const {
+	VDJitterBufferRef jitter = std::atomic_load(&getSource(aSource).jitter);
+	return jitter ? jitter->getStats() : VDJitterStats();
+}
 
-				if (json.hasChild("event")) {
-					JsonTree jsonEvent = json.getChild("event");
-					string val = jsonEvent.getValue();
-					// check if message exists
-					if (json.hasChild("message")) {
-						if (val == "canvas") {
-							// we received a jpeg base64
-							mBase64String = json.getChild("message").getValue<string>();
-							streamReceived = true;
-						}
-						else if (val == "params") {
-							//{"event":"params","message":"{\"params\" :[{\"name\" : 12,\"value\" :0.132}]}"}
-							JsonTree jsonParams = json.getChild("message");
-							for (JsonTree::ConstIter jsonElement = jsonParams.begin(); jsonElement != jsonParams.end(); ++jsonElement) {
-								int name = jsonElement->getChild("name").getValue<int>();
-								float value = jsonElement->getChild("value").getValue<float>();
-
-								// basic name value 
-								//mVDAnimation->setFloatUniformValueByIndex(name, value);
-							}
-						}
-						else if (val == "hydra") {
-							receivedUniformsString = json.getChild("message").getValue<string>();
-							shaderUniforms = true;
-							// force to display
-							//mVDAnimation->setIntUniformValueByIndex(mVDSettings->IFBOA, 0);
-							//mVDAnimation->setIntUniformValueByIndex(mVDSettings->IFBOB, 1);
-						}
-						/*else if (val == "editortext") {
-							// we received a fragment shader string from hydra
-							receivedFragString = json.getChild("message").getValue<string>();
-							shaderReceived = true;
-							// force to display
-							mVDAnimation->setIntUniformValueByIndex(mVDSettings->IFBOA, 0);
-							mVDAnimation->setIntUniformValueByIndex(mVDSettings->IFBOB, 1);
-						}*/
-						else if (val == "frag") {
-							// we received a fragment shader string
-							receivedFragString = json.getChild("message").getValue<string>();
-							shaderReceived = true;
-							// force to display
-							//mVDAnimation->setIntUniformValueByIndex(mVDSettings->IFBOA, 0);
-							//mVDAnimation->setIntUniformValueByIndex(mVDSettings->IFBOB, 1);
-						}
-						else {
-							// we received a fragment shader string
-							//CI_LOG_V("VDWebsocket unknown event: " + val);
-						}
-						//string evt = json.getChild("event").getValue<string>();
-					}
-				}
+const double VDWebsocket::kPingInterval = 2.0;
 
+void VDWebsocket::wsPing() {
+	// the pongs give the round trip of getConnectionStats()
+	for (auto &source : mSources) {
+		VDWebsocketSource *s = source.get();
+		post([s]() {
+			if (s->connected) s->client->ping();
+		});
+	}
+	mPingTime = getElapsedSeconds();
+}
+void VDWebsocket::post(const std::function<void()> &aTask) {
+	// a task still queued at shutdown is destroyed with the io_service without running
+	mIoService.post(aTask);
+}
+bool VDWebsocket::acquireCanvasFrame(unsigned int aSource, Surface8uRef &aSurface) {
+	VDCanvasFrame frame;
+	if (!getSource(aSource).canvasDecoder->acquireFrame(frame)) return false;
+	aSurface = frame.surface;
+	// decoding is the parse stage of a canvas frame
+	mLatency->record(VDLatencyTracker::CANVAS, VDLatencyTracker::PARSED, frame.received, frame.decoded);
+	applied(VDLatencyTracker::CANVAS, frame.received);
+	return true;
+}
+void VDWebsocket::beginMessage(VDWebsocketSource *aSource, uint64_t aReceived, const std::shared_ptr<void> &aOwner) {
+	mCurrentSource = aSource;
+	mMessageReceived = aReceived;
+	mMessageOwner = aOwner;
+	mMessageType = VDLatencyTracker::OTHER;
+	// a jittered table is stamped by the render thread
+	if (!std::atomic_load(&aSource->jitter)) aSource->uniforms->setReceiveTime(aReceived);
+}
+void VDWebsocket::endMessage() {
+	// canvas frames are measured once decoded, see acquireCanvasFrame()
+	if (mMessageType != VDLatencyTracker::CANVAS) mLatency->record(mMessageType, VDLatencyTracker::PARSED, mMessageReceived);
+	mMessageOwner.reset();
+}
+void VDWebsocket::applied(VDLatencyTracker::Type aType, uint64_t aReceived) {
+	if (aReceived == 0) return;
+	mLatency->record(aType, VDLatencyTracker::APPLIED, aReceived);
+	uint64_t &pending = mPresentPending[aType];
+	if (pending == 0 || aReceived < pending) pending = aReceived;
+}
+void VDWebsocket::framePresented() {
+	uint64_t now = VDLatencyTracker::now();
+	for (int type = 0; type < VDLatencyTracker::TYPE_COUNT; type++) {
+		mLatency->record((VDLatencyTracker::Type)type, VDLatencyTracker::PRESENTED, mPresentPending[type], now);
+		mPresentPending[type] = 0;
+	}
+	mLatency->update(getElapsedSeconds());
+	mMetrics.frame(now);
+	if (getElapsedSeconds() - mMetricsTime >= kMetricsInterval) publishMetrics();
+}
+const double VDWebsocket::kMetricsInterval = 1.0;
+
+void VDWebsocket::publishMetrics() {
+	std::shared_ptr<VDMetricsSnapshot> snapshot(new VDMetricsSnapshot());
+	snapshot->uptime = getElapsedSeconds();
+	for (int type = 0; type < VDLatencyTracker::TYPE_COUNT; type++) {
+		for (int stage = 0; stage < VDLatencyTracker::STAGE_COUNT; stage++) {
+			snapshot->latency[type][stage] = mLatency->getSummary((VDLatencyTracker::Type)type, (VDLatencyTracker::Stage)stage);
+		}
+	}
+	// shader patches are totals over the sources
+	VDShaderPatchStats patches = { 0, 0, 0, 0 };
+	for (unsigned int i = 0; i < mSources.size(); i++) {
+		VDMetricsSource source;
+		source.connected = mSources[i]->connected;
+		source.connection = getConnectionStats(i);
+		source.canvas = getCanvasStats(i);
+		source.jitter = getJitterStats(i);
+		snapshot->sources.push_back(source);
+		VDShaderPatchStats sourcePatches = getShaderPatchStats(i);
+		patches.applied += sourcePatches.applied;
+		patches.rejected += sourcePatches.rejected;
+		patches.patchBytes += sourcePatches.patchBytes;
+		patches.textBytes += sourcePatches.textBytes;
+	}
+	snapshot->inboxDropped = mInboxDropped;
+	snapshot->unhandledMessages = mUnhandledMessages;
+	snapshot->osc = getOscReceiverStats();
+	snapshot->shaderPatches = patches;
+	snapshot->custom = mCustomMetrics;
+	mMetrics.publish(snapshot);
+	mMetricsTime = getElapsedSeconds();
+}
+bool VDWebsocket::startMetricsServer(uint16_t aPort) {
+	// the acceptor lives on mIoService, nothing may be running it meanwhile
+	bool threaded = mNetworkThreaded;
+	stopNetworkThread();
+	if (!mMetricsServer) {
+		// created once: pending accepts on the shared io_service refer to it
+		mMetricsServer.reset(new WebSocketServer(&mIoService));
+		// the port of a scraped server is in TIME_WAIT for a while after stopMetricsServer()
+		mMetricsServer->getServer().set_reuse_addr(true);
+		mMetricsServer->connectHttpRequestEventHandler([this](const string &aResource, WebSocketHttpResponse &aResponse) {
+			return mMetrics.handleRequest(aResource, aResponse.contentType, aResponse.body);
+		});
+		mMetricsServer->connectFailEventHandler([](string err) {
+			CI_LOG_W("metrics server: " << err);
+		});
+	}
+	if (isMetricsServing()) mMetricsServer->cancel();
+	mMetricsServer->listen(aPort);
+	bool serving = isMetricsServing();
+	if (threaded) startNetworkThread();
+	return serving;
+}
+void VDWebsocket::stopMetricsServer() {
+	if (!isMetricsServing()) return;
+	bool threaded = mNetworkThreaded;
+	stopNetworkThread();
+	mMetricsServer->cancel();
+	if (threaded) startNetworkThread();
+}
+void VDWebsocket::parseParams(VDJsonReader &aReader) {
+	//[{"name" : 12,"value" :0.132}]
+	mMessageType = VDLatencyTracker::UNIFORMS;
+	if (!aReader.beginArray()) return;
+	while (aReader.nextElement()) {
+		if (!aReader.beginObject()) return;
+		int name = -1;
+		float value = 0.0f;
+		bool hasValue = false;
+		VDStringRef key;
+		while (aReader.nextKey(key)) {
+			if (key.equals("name")) aReader.readInt(name);
+			else if (key.equals("value")) hasValue = aReader.readFloat(value);
+			else aReader.skipValue();
+		}
+		if (aReader.failed()) return;
+		// basic name value 
+		if (name >= 0 && hasValue) updateParams(name, value);
+	}
+}
+void VDWebsocket::parseK2(VDJsonReader &aReader) {
+	//[{"name" : 61,"value" : "0.1,0.2,0.3,1.0"}]
+	mMessageType = VDLatencyTracker::UNIFORMS;
+	if (!aReader.beginArray()) return;
+	while (aReader.nextElement()) {
+		if (!aReader.beginObject()) return;
+		int name = -1;
+		vec4 v;
+		int components = 0;
+		VDStringRef key;
+		while (aReader.nextKey(key)) {
+			if (key.equals("name")) {
+				aReader.readInt(name);
+			}
+			else if (key.equals("value")) {
+				VDStringRef raw;
+				if (!aReader.readString(raw)) break;
+				const char *p = raw.data;
+				const char *end = raw.data + raw.size;
+				while (components < 4 && p < end) {
+					float f;
+					size_t consumed = VDJsonReader::parseFloat(p, end, f);
+					if (consumed == 0) break;
+					v[components++] = f;
+					p += consumed;
+					while (p < end && (*p == ',' || *p == ' ')) p++;
+				}
 			}
-			catch (cinder::JsonTree::Exception exception) {
-				/*mVDSettings->mWebSocketsMsg += " error jsonparser exception: ";
-				mVDSettings->mWebSocketsMsg += exception.what();
-				mVDSettings->mWebSocketsMsg += "  ";*/
+			else {
+				aReader.skipValue();
 			}
 		}
-		else if (msg.substr(0, 2) == "/*") {
-			// shader with json info				
-			unsigned closingCommentPosition = msg.find("*/");
-			if (closingCommentPosition > 0) {
-				JsonTree json;
-				try {
-					// create folders if they don't exist
-					fs::path pathsToCheck = getAssetPath("") / "glsl";
-					if (!fs::exists(pathsToCheck)) fs::create_directory(pathsToCheck);
-					pathsToCheck = getAssetPath("") / "glsl" / "received";
-					if (!fs::exists(pathsToCheck)) fs::create_directory(pathsToCheck);
-					pathsToCheck = getAssetPath("") / "glsl" / "processed";
-					if (!fs::exists(pathsToCheck)) fs::create_directory(pathsToCheck);
-					// find commented header
-					string jsonHeader = msg.substr(2, closingCommentPosition - 2);
-					ci::JsonTree::ParseOptions parseOptions;
-					parseOptions.ignoreErrors(false);
-					json = JsonTree(jsonHeader, parseOptions);
-					string title = json.getChild("title").getValue<string>();
-					string fragFileName = title + ".frag"; // with uniforms
-					string glslFileName = title + ".glsl"; // without uniforms, need to include shadertoy.inc
-					string shader = msg.substr(closingCommentPosition + 2);
-
-					string processedContent = "/*" + jsonHeader + "*/";
-					// check uniforms presence
-					std::size_t foundUniform = msg.find("uniform");
-
-					if (foundUniform != std::string::npos) {
-						// found uniforms
-					}
-					else {
-						// save glsl file without uniforms as it was received
-						fs::path currentFile = getAssetPath("") / "glsl" / "received" / glslFileName;
-						/*ofstream mFrag(currentFile.string(), std::ofstream::binary);
-						mFrag << msg;
-						mFrag.close();*/
-
-
-						// uniforms not found, add include
-						processedContent += "#include shadertoy.inc";
-					}
-					processedContent += shader;
-
-					// save processed file
-					/*fs::path processedFile = getAssetPath("") / "glsl" / "processed" / fragFileName;
-					ofstream mFragProcessed(processedFile.string(), std::ofstream::binary);
-					mFragProcessed << processedContent;
-					mFragProcessed.close();
-					CI_LOG_V("processed file saved:" + processedFile.string());*/
-
-				}
-				catch (cinder::JsonTree::Exception exception) {
-					/*mVDSettings->mWebSocketsMsg += " error jsonparser exception: ";
-					mVDSettings->mWebSocketsMsg += exception.what();
-					mVDSettings->mWebSocketsMsg += "  ";*/
-				}
+		if (aReader.failed()) return;
+		if (name >= 0 && components == 4) {
+			// basic name value 
+			setVec4Uniform(name, v);
+		}
+	}
+}
+void VDWebsocket::parseEvent(const VDStringRef &aEvent, const VDStringRef &aMessage, int aVersion) {
+	// aMessage is the raw json value, strings still have their quotes
+	bool isString = aMessage.size >= 2 && aMessage.data[0] == '"';
+	VDStringRef content = isString ? VDStringRef(aMessage.data + 1, aMessage.size - 2) : aMessage;
+	if (aEvent.equals("canvas")) {
+		// we received a jpeg base64, no escapes in base64
+		mMessageType = VDLatencyTracker::CANVAS;
+		mCurrentSource->canvasDecoder->submitBase64(content.data, content.size, mMessageReceived, mMessageOwner);
+	}
+	else if (aEvent.equals("params")) {
+		//{"event":"params","message":"{\"params\" :[{\"name\" : 12,\"value\" :0.132}]}"}
+		if (isString) {
+			VDJsonReader::unescape(content, mUnescapeBuffer);
+			VDJsonReader reader(mUnescapeBuffer.data(), mUnescapeBuffer.data() + mUnescapeBuffer.size());
+			if (!reader.beginObject()) return;
+			VDStringRef key;
+			while (reader.nextKey(key)) {
+				if (key.equals("params")) parseParams(reader);
+				else reader.skipValue();
 			}
 		}
-
-		else if (msg.substr(0, 7) == "#version") {
-			// fragment shader from live coding
-			// route it to websockets clients
-			//if (mVDSettings->mIsRouter) {
-			wsWrite(msg);
-			//}
+		else {
+			VDJsonReader reader(content);
+			parseParams(reader);
 		}
-		else if (first == "/")
-		{
-			// osc from videodromm-nodejs-router
-			/*int f = msg.size();
-			const char c = msg[9];
-			int s = msg[12];
-			int t = msg[13];
-			int u = msg[14];*/
-
+	}
+	else if (aEvent.equals("hydra")) {
+		deliverShader(VDShaderCache::HYDRA, VDWebsocketEvent::UNIFORMS, content, aVersion);
+		// force to display
+		//mVDAnimation->setIntUniformValueByIndex(mVDSettings->IFBOA, 0);
+		//mVDAnimation->setIntUniformValueByIndex(mVDSettings->IFBOB, 1);
+	}
+	else if (aEvent.equals("frag")) {
+		// we received a fragment shader string
+		deliverShader(VDShaderCache::FRAG, VDWebsocketEvent::SHADER, content, aVersion);
+		// force to display
+		//mVDAnimation->setIntUniformValueByIndex(mVDSettings->IFBOA, 0);
+		//mVDAnimation->setIntUniformValueByIndex(mVDSettings->IFBOB, 1);
+	}
+	else if (aEvent.equals("patch")) {
+		// an edit of the last frag or hydra text, see parseShaderPatch()
+		if (isString) {
+			VDJsonReader::unescape(content, mUnescapeBuffer);
+			VDJsonReader reader(mUnescapeBuffer.data(), mUnescapeBuffer.data() + mUnescapeBuffer.size());
+			parseShaderPatch(reader);
+		}
+		else {
+			VDJsonReader reader(content);
+			parseShaderPatch(reader);
+		}
+	}
+	else {
+		// unknown event
+		//CI_LOG_V("VDWebsocket unknown event: " + aEvent.str());
+	}
+}
+void VDWebsocket::parseJson(const VDStringRef &aJson) {
+	// single pass over the payload, each handler gets a view into it
+	VDJsonReader reader(aJson);
+	if (!reader.beginObject()) return;
+	VDStringRef key;
+	VDStringRef eventName;
+	VDStringRef message;
+	// of frag and hydra text, the base of the next patches
+	int version = 0;
+	while (reader.nextKey(key)) {
+		if (key.equals("params")) {
+			// web controller
+			parseParams(reader);
+		}
+		else if (key.equals("k2")) {
+			parseK2(reader);
+		}
+		else if (key.equals("event")) {
+			reader.readString(eventName);
 		}
-		else if (first == "I") {
-
-			if (msg == "ImInit") {
-				// send ImInit OK
-				/*if (!remoteClientActive) { remoteClientActive = true; ForceKeyFrame = true;
-				// Send confirmation mServer.write("ImInit"); // Send font texture unsigned char* pixels; int width, height;
-				ImGui::GetIO().Fonts->GetTexDataAsAlpha8(&pixels, &width, &height); PreparePacketTexFont(pixels, width, height);SendPacket();
-				}*/
+		else if (key.equals("message")) {
+			reader.readValue(message);
+		}
+		else if (key.equals("version")) {
+			reader.readInt(version);
+		}
+		else {
+			reader.skipValue();
+		}
+	}
+	if (reader.failed()) {
+		//mVDSettings->mWebSocketsMsg += " error json reader";
+		return;
+	}
+	// check if message exists
+	if (!eventName.empty() && !message.empty()) parseEvent(eventName, message, version);
+}
+bool VDWebsocket::parseCanvas(const VDStringRef &aMessage) {
+	// hydra sends {"event":"canvas","message":"<base64>"}, recognize it by its prefix
+	// so a multi-megabyte frame skips the key by key walk of parseJson()
+	static const char prefix[] = "{\"event\":\"canvas\",\"message\":\"";
+	static const size_t prefixLength = sizeof(prefix) - 1;
+	if (!aMessage.startsWith(prefix, prefixLength)) return false;
+	// the message string ends at its closing quote, other keys may follow it
+	VDJsonReader reader(aMessage.data + prefixLength - 1, aMessage.data + aMessage.size);
+	VDStringRef content;
+	if (!reader.readString(content)) return false;
+	mMessageType = VDLatencyTracker::CANVAS;
+	mCurrentSource->canvasDecoder->submitBase64(content.data, content.size, mMessageReceived, mMessageOwner);
+	return true;
+}
+void VDWebsocket::parseBinary(const void *aData, size_t aSize) {
+	// header then raw jpeg or rgba: no base64, no utf-8 validation, no json scan
+	const uint8_t *data = (const uint8_t *)aData;
+	VDCanvasHeader header;
+	if (!VDCanvasHeader::parse(data, aSize, header)) {
+		if (VDOscDecoder::isPacket(aData, aSize)) {
+			parseOsc(aData, aSize);
+			return;
+		}
+		//CI_LOG_V("VDWebsocket unknown binary message");
+		return;
+	}
+	mMessageType = VDLatencyTracker::CANVAS;
+	mCurrentSource->canvasDecoder->submitBinary(header, data + VDCanvasHeader::kSize, aSize - VDCanvasHeader::kSize, mMessageReceived, mMessageOwner);
+}
+void VDWebsocket::deliverShader(VDShaderCache::Kind aKind, VDWebsocketEvent::Type aType, const VDStringRef &aContent, int aVersion) {
+	// aContent is still escaped, an unchanged resend is dropped before unescaping it
+	mMessageType = VDLatencyTracker::SHADER;
+	uint64_t hash = VDShaderCache::hash(aContent.data, aContent.size);
+	if (mShaderCache->isRepeat(mCurrentSource->shaderHistory, aKind, hash, aContent.size)) {
+		mCurrentSource->shaderPatcher.setVersion(aKind, aVersion);
+		return;
+	}
+	mEvent.type = aType;
+	VDProcessedShaderRef shader = mShaderCache->find(aKind, hash);
+	if (shader) {
+		mEvent.payload.assign(shader->content);
+	}
+	else {
+		VDJsonReader::unescape(aContent, mEvent.payload);
+		VDProcessedShader *processed = new VDProcessedShader();
+		processed->hasUniforms = true;
+		processed->content = mEvent.payload;
+		mShaderCache->insert(aKind, hash, VDProcessedShaderRef(processed));
+	}
+	mCurrentSource->shaderPatcher.setText(aKind, aVersion, mEvent.payload);
+	mEvent.received = mMessageReceived;
+	deliverEvent(mEvent);
+}
+void VDWebsocket::parseShaderPatch(VDJsonReader &aReader) {
+	//{"kind":"frag","base":12,"version":13,"splices":[[120,3,"sin"],[400,0,"\n"]]}
+	mMessageType = VDLatencyTracker::SHADER;
+	if (!aReader.beginObject()) return;
+	VDStringRef key;
+	VDStringRef kind;
+	VDStringRef splices;
+	int base = 0;
+	int version = 0;
+	while (aReader.nextKey(key)) {
+		if (key.equals("kind")) aReader.readString(kind);
+		else if (key.equals("base")) aReader.readInt(base);
+		else if (key.equals("version")) aReader.readInt(version);
+		else if (key.equals("splices")) aReader.readValue(splices);
+		else aReader.skipValue();
+	}
+	if (aReader.failed() || splices.empty()) return;
+	VDShaderCache::Kind shaderKind = kind.equals("hydra") ? VDShaderCache::HYDRA : VDShaderCache::FRAG;
+	VDShaderPatcher &patcher = mCurrentSource->shaderPatcher;
+	if (!patcher.apply(shaderKind, base, version, splices)) {
+		// the resend must be delivered even if it matches the last full payload
+		VDShaderCache::forgetLast(mCurrentSource->shaderHistory, shaderKind);
+		requestShaderResend(shaderKind);
+		return;
+	}
+	// the text is new, a full resend of the previous one is not a repeat anymore
+	VDShaderCache::forgetLast(mCurrentSource->shaderHistory, shaderKind);
+	mEvent.type = shaderKind == VDShaderCache::HYDRA ? VDWebsocketEvent::UNIFORMS : VDWebsocketEvent::SHADER;
+	mEvent.payload.assign(patcher.getText(shaderKind));
+	mEvent.received = mMessageReceived;
+	deliverEvent(mEvent);
+}
+void VDWebsocket::requestShaderResend(VDShaderCache::Kind aKind) {
+	// answered on the connection the patch came from, a replay has nobody to ask
+	if (mReplaying || !mCurrentSource->connected) return;
+	//{"event":"resend","message":{"kind":"frag","version":12}}
+	VDMessageBuilder builder;
+	builder.beginObject();
+	builder.key("event");
+	builder.value("resend");
+	builder.key("message");
+	builder.beginObject();
+	builder.key("kind");
+	builder.value(aKind == VDShaderCache::HYDRA ? "hydra" : "frag");
+	builder.key("version");
+	builder.value(mCurrentSource->shaderPatcher.getVersion(aKind));
+	builder.endObject();
+	builder.endObject();
+	mCurrentSource->client->write(builder.finish());
+}
+void VDWebsocket::parseShaderHeader(const VDStringRef &aMessage) {
+	// shader with json info
+	mMessageType = VDLatencyTracker::SHADER;
+	uint64_t hash = VDShaderCache::hash(aMessage.data, aMessage.size);
+	if (mShaderCache->isRepeat(mCurrentSource->shaderHistory, VDShaderCache::HEADER, hash, aMessage.size)) return;
+	// switching back to a recent shader skips the json parse and the rebuild
+	VDProcessedShaderRef shader = mShaderCache->find(VDShaderCache::HEADER, hash);
+	if (!shader) {
+		shader = processShaderHeader(aMessage);
+		if (!shader) return;
+		mShaderCache->insert(VDShaderCache::HEADER, hash, shader);
+	}
+	mEvent.type = VDWebsocketEvent::SHADER;
+	mEvent.payload.assign(shader->content);
+	mEvent.received = mMessageReceived;
+	deliverEvent(mEvent);
+}
+VDProcessedShaderRef VDWebsocket::processShaderHeader(const VDStringRef &aMessage) {
+	string msg = aMessage.str();
+	size_t closingCommentPosition = msg.find("*/");
+	if (closingCommentPosition != string::npos) {
+		JsonTree json;
+		try {
+			// find commented header
+			string jsonHeader = msg.substr(2, closingCommentPosition - 2);
+			ci::JsonTree::ParseOptions parseOptions;
+			parseOptions.ignoreErrors(false);
+			json = JsonTree(jsonHeader, parseOptions);
+			string title = json.getChild("title").getValue<string>();
+			string fragFileName = title + ".frag"; // with uniforms
+			string glslFileName = title + ".glsl"; // without uniforms, need to include shadertoy.inc
+			string shader = msg.substr(closingCommentPosition + 2);
+
+			string processedContent = "/*" + jsonHeader + "*/";
+			// check uniforms presence
+			std::size_t foundUniform = msg.find("uniform");
+
+			if (foundUniform != std::string::npos) {
+				// found uniforms
 			}
-			else if (msg.substr(0, 11) == "ImMouseMove") {
-				/*string trail = msg.substr(12);
-				unsigned commaPosition = trail.find(",");
-				if (commaPosition > 0) { mouseX = atoi(trail.substr(0, commaPosition).c_str());
-				mouseY = atoi(trail.substr(commaPosition + 1).c_str()); ImGuiIO& io = ImGui::GetIO();
-				io.MousePos = toPixels(vec2(mouseX, mouseY)); }*/
+			else {
+				// save glsl file without uniforms as it was received
+				mShaderArchive->write(VDShaderArchive::RECEIVED, glslFileName, msg);
+				// uniforms not found, add include
+				processedContent += "#include shadertoy.inc";
 			}
-			else if (msg.substr(0, 12) == "ImMousePress") {
-				/*ImGuiIO& io = ImGui::GetIO(); // 1,0 left click 1,1 right click
-				io.MouseDown[0] = false; io.MouseDown[1] = false; int rightClick = atoi(msg.substr(15).c_str());
-				if (rightClick == 1) { io.MouseDown[0] = false; io.MouseDown[1] = true; }
-				else { io.MouseDown[0] = true; io.MouseDown[1] = false;
-				}*/
+			processedContent += shader;
+
+			// save processed file, written by the archive thread
+			mShaderArchive->write(VDShaderArchive::PROCESSED, fragFileName, processedContent);
+
+			VDProcessedShader *processed = new VDProcessedShader();
+			processed->title = title;
+			processed->hasUniforms = foundUniform != std::string::npos;
+			processed->content.swap(processedContent);
+			return VDProcessedShaderRef(processed);
+		}
+		catch (cinder::JsonTree::Exception exception) {
+			/*mVDSettings->mWebSocketsMsg += " error jsonparser exception: ";
+			mVDSettings->mWebSocketsMsg += exception.what();
+			mVDSettings->mWebSocketsMsg += "  ";*/
+		}
+	}
+	return nullptr;
+}
+void VDWebsocket::parseBatch(const VDStringRef &aMessage) {
+	// [{"cmd":...},{"event":"frag","message":"..."}] as sent by flush()
+	VDJsonReader reader(aMessage);
+	if (!reader.beginArray()) return;
+	while (reader.nextElement()) {
+		VDStringRef element;
+		if (!reader.readValue(element)) return;
+		if (!element.empty() && element.data[0] == '{') parseJson(element);
+	}
+}
+void VDWebsocket::addDefaultHandlers() {
+	mDispatcher.addHandler("{", [this](const VDStringRef &aMessage) {
+		// json
+		if (!parseCanvas(aMessage)) parseJson(aMessage);
+	});
+	mDispatcher.addHandler("[", [this](const VDStringRef &aMessage) {
+		parseBatch(aMessage);
+	});
+	mDispatcher.addHandler("/*", [this](const VDStringRef &aMessage) {
+		parseShaderHeader(aMessage);
+	});
+	mDispatcher.addHandler("#version", [this](const VDStringRef &aMessage) {
+		// fragment shader from live coding
+		// route it to websockets clients
+		//if (mVDSettings->mIsRouter) {
+		wsWrite(aMessage.str());
+		//}
+	});
+	mDispatcher.addHandler("/", [this](const VDStringRef &aMessage) {
+		// osc from videodromm-nodejs-router
+		parseOsc(aMessage.data, aMessage.size);
+	});
+	mDispatcher.addHandler("#bundle", [this](const VDStringRef &aMessage) {
+		parseOsc(aMessage.data, aMessage.size);
+	});
+	addDefaultOscRoutes();
+	mDispatcher.addHandler("ImInit", [this](const VDStringRef &aMessage) {
+		// send ImInit OK
+		/*if (!remoteClientActive) { remoteClientActive = true; ForceKeyFrame = true;
+		// Send confirmation mServer.write("ImInit"); // Send font texture unsigned char* pixels; int width, height;
+		ImGui::GetIO().Fonts->GetTexDataAsAlpha8(&pixels, &width, &height); PreparePacketTexFont(pixels, width, height);SendPacket();
+		}*/
+	});
+	mDispatcher.addHandler("ImMouseMove", [this](const VDStringRef &aMessage) {
+		/*string trail = msg.substr(12);
+		unsigned commaPosition = trail.find(",");
+		if (commaPosition > 0) { mouseX = atoi(trail.substr(0, commaPosition).c_str());
+		mouseY = atoi(trail.substr(commaPosition + 1).c_str()); ImGuiIO& io = ImGui::GetIO();
+		io.MousePos = toPixels(vec2(mouseX, mouseY)); }*/
+	});
+	mDispatcher.addHandler("ImMousePress", [this](const VDStringRef &aMessage) {
+		/*ImGuiIO& io = ImGui::GetIO(); // 1,0 left click 1,1 right click
+		io.MouseDown[0] = false; io.MouseDown[1] = false; int rightClick = atoi(msg.substr(15).c_str());
+		if (rightClick == 1) { io.MouseDown[0] = false; io.MouseDown[1] = true; }
+		else { io.MouseDown[0] = true; io.MouseDown[1] = false;
+		}*/
+	});
+}
+void VDWebsocket::parseOsc(const void *aData, size_t aSize) {
+	// decoded in place, values go straight to the uniform table without json.
+	// bundle timetags schedule values only through a jitter buffer, see setJitterDelay()
+	mMessageType = VDLatencyTracker::UNIFORMS;
+	VDOscDecoder::decode(aData, aSize, [this](VDOscMessage &aMessage) {
+		// ntp time, 1 means immediately
+		uint64_t timetag = aMessage.timetag;
+		mMessageSenderTime = timetag > 1 ? (timetag >> 32) * 1000000 + (((timetag & 0xffffffff) * 1000000) >> 32) : 0;
+		if (mOscRouter.dispatch(aMessage) == 0) mUnhandledMessages++;
+	});
+	mMessageSenderTime = 0;
+}
+void VDWebsocket::addDefaultOscRoutes() {
+	// /params 12 0.132 [13 0.5 ...]
+	mOscRouter.addRoute("/params", [this](VDOscMessage &aMessage) {
+		VDOscArgument name, value;
+		while (aMessage.nextArgument(name) && aMessage.nextArgument(value)) {
+			int index;
+			float f;
+			if (name.toInt(index) && value.toFloat(f)) updateParams(index, f);
+		}
+	});
+	// /k2 61 0.1 0.2 0.3 1.0
+	mOscRouter.addRoute("/k2", [this](VDOscMessage &aMessage) {
+		VDOscArgument argument;
+		int name;
+		if (!aMessage.nextArgument(argument) || !argument.toInt(name) || name < 0) return;
+		vec4 v;
+		for (int i = 0; i < 4; i++) {
+			if (!aMessage.nextArgument(argument) || !argument.toFloat(v[i])) return;
+		}
+		setVec4Uniform(name, v);
+	});
+}
+void VDWebsocket::addOscRoute(const string &aAddress, unsigned int aUniform) {
+	addOscHandler(aAddress, [this, aUniform](VDOscMessage &aMessage) {
+		VDOscArgument argument;
+		float value;
+		while (aMessage.nextArgument(argument)) {
+			if (argument.toFloat(value)) {
+				updateParams(aUniform, value);
+				return;
 			}
 		}
+	});
+}
+void VDWebsocket::addOscHandler(const string &aAddress, const VDOscRouter::Handler &aHandler) {
+	// the routes are read without a lock, they change between packets on the io_service
+	post([this, aAddress, aHandler]() { mOscRouter.addRoute(aAddress, aHandler); });
+}
+void VDWebsocket::removeOscRoute(const string &aAddress) {
+	post([this, aAddress]() { mOscRouter.removeRoute(aAddress); });
+}
+bool VDWebsocket::startOscReceiver(uint16_t aPort, unsigned int aSource) {
+	stopOscReceiver();
+	VDWebsocketSource *source = mSources[aSource < mSources.size() ? aSource : 0].get();
+	mOscReceiver = VDOscReceiver::create(mIoService, [this, source](const VDOscDatagram *aDatagrams, size_t aCount) {
+		if (mReplaying) return;
+		VDTrafficRecorderRef recorder = std::atomic_load(&mRecorder);
+		uint64_t received = VDLatencyTracker::now();
+		for (size_t i = 0; i < aCount; i++) {
+			// replayed as binary messages, which fall back to osc
+			if (recorder) recorder->record(VDTrafficCapture::BINARY, (uint8_t)source->id, aDatagrams[i].data, aDatagrams[i].size);
+			beginMessage(source, received);
+			parseOsc(aDatagrams[i].data, aDatagrams[i].size);
+			endMessage();
+		}
+		// one publish per batch on the network thread
+		if (mNetworkThreaded) publishUniforms(*source);
+	});
+	if (!mOscReceiver->open(aPort)) {
+		mOscReceiver.reset();
+		return false;
 	}
+	return true;
+}
+void VDWebsocket::stopOscReceiver() {
+	if (!mOscReceiver) return;
+	mOscReceiver->close();
+	mOscReceiver.reset();
+}
+void VDWebsocket::addMessageHandler(const string &aPrefix, const VDPrefixHandler &aHandler) {
+	// the table is read without a lock, it changes between messages on the io_service
+	post([this, aPrefix, aHandler]() { mDispatcher.addHandler(aPrefix, aHandler); });
+}
+void VDWebsocket::removeMessageHandler(const string &aPrefix) {
+	post([this, aPrefix]() { mDispatcher.removeHandler(aPrefix); });
+}
+//dreads(1, 0, 0.8).out(o0)
+void VDWebsocket::parseMessage(const VDStringRef &aMessage) {
+	// classified in place by the prefix table, see addDefaultHandlers()
+	if (!mDispatcher.dispatch(aMessage)) mUnhandledMessages++;
 }
 string VDWebsocket::getReceivedShader() {
 	shaderReceived = false;
+	applied(VDLatencyTracker::SHADER, mShaderReceived);
+	mShaderReceived = 0;
 	return receivedFragString;
 }
 string VDWebsocket::getReceivedUniforms() {
 	shaderUniforms = false;
+	applied(VDLatencyTracker::SHADER, mHydraReceived);
+	mHydraReceived = 0;
 	return receivedUniformsString;
 }
 
 void VDWebsocket::wsConnect() {
-
-
-	mClient.connectOpenEventHandler([&]() {
-		clientConnected = true;
+	connectSource(*mSources[0]);
+}
+void VDWebsocket::connectSource(VDWebsocketSource &aSource) {
+	// handlers keep a pointer to their source, sources live as long as the VDWebsocket
+	VDWebsocketSource *source = &aSource;
+	aSource.client->connectOpenEventHandler([source]() {
+		source->connected = true;
+		source->connection->onOpen();
 		//mVDSettings->mWebSocketsMsg = "Connected";
 		//mVDSettings->mWebSocketsNewMsg = true;
 	});
-	mClient.connectCloseEventHandler([&]() {
-		clientConnected = false;
+	aSource.client->connectCloseEventHandler([source]() {
+		source->connected = false;
+		source->connection->onClose();
 		//mVDSettings->mWebSocketsMsg = "Disconnected";
 		//mVDSettings->mWebSocketsNewMsg = true;
 	});
-	mClient.connectFailEventHandler([&](string err) {
+	aSource.client->connectFailEventHandler([source](string err) {
 		//mVDSettings->mWebSocketsMsg = "WS Error";
 		//mVDSettings->mWebSocketsNewMsg = true;
 		if (!err.empty()) {
 			//mVDSettings->mWebSocketsMsg += ": " + err;
 		}
+		source->connection->onFail(err);
 	});
-	mClient.connectInterruptEventHandler([&]() {
+	aSource.client->connectInterruptEventHandler([]() {
 		//mVDSettings->mWebSocketsMsg = "WS Interrupted";
 		//mVDSettings->mWebSocketsNewMsg = true;
 	});
-	mClient.connectPingEventHandler([&](string msg) {
+	aSource.client->connectPingEventHandler([](string msg) {
 		//mVDSettings->mWebSocketsMsg = "WS Ponged";
 		//mVDSettings->mWebSocketsNewMsg = true;
 		if (!msg.empty())
@@ -286,52 +882,76 @@ void VDWebsocket::wsConnect() {
 			//mVDSettings->mWebSocketsMsg += ": " + msg;
 		}
 	});
-	mClient.connectMessageEventHandler([&](string msg) {
-		parseMessage(msg);
+	// parsed in place in the websocketpp buffer, canvas payloads keep it alive until decoded
+	aSource.client->connectMessageViewEventHandler([this, source](const WebSocketMessageView &msg) {
+		if (mReplaying) return;
+		bool binary = msg.opcode == websocketpp::frame::opcode::BINARY;
+		VDTrafficRecorderRef recorder = std::atomic_load(&mRecorder);
+		if (recorder) recorder->record(binary ? VDTrafficCapture::BINARY : VDTrafficCapture::TEXT, (uint8_t)source->id, msg.data, msg.size);
+		beginMessage(source, VDLatencyTracker::toMicros(source->client->getMessageTime()), msg.keepAlive);
+		if (binary) {
+			parseBinary(msg.data, msg.size);
+		}
+		else {
+			parseMessage(VDStringRef(msg.data, msg.size));
+		}
+		endMessage();
+		// on the network thread every message is published right away, osc in binary frames
+		// included. the render thread still swaps only once per frame
+		if (mNetworkThreaded) publishUniforms(*source);
 	});
-	wsClientConnect();
-
-
-	clientConnected = true;
+	// connected once the open event arrives
+	source->connection->start();
 
 }
 
 void VDWebsocket::wsClientConnect()
 {
 
-	stringstream s;
 	/*if (mVDSettings->mWebSocketsPort == 80) {
 		s << mVDSettings->mWebSocketsProtocol << mVDSettings->mWebSocketsHost;
 	}
 	else {
 		s << mVDSettings->mWebSocketsProtocol << mVDSettings->mWebSocketsHost << ":" << mVDSettings->mWebSocketsPort;
 	}*/
-	// BL TEMP 
-	s << "ws://127.0.0.1:8088";
-	mClient.connect(s.str());
+	// resolve, connect and reconnect happen asynchronously, see setEndpoints()
+	for (auto &source : mSources) source->connection->start();
 
 }
 void VDWebsocket::wsClientDisconnect()
 {
 
-	if (clientConnected)
-	{
-		mClient.disconnect();
-	}
+	for (auto &source : mSources) source->connection->stop();
 
 }
+void VDWebsocket::setEndpoints(const vector<string> &aEndpoints, unsigned int aSource) {
+	getSource(aSource).connection->setEndpoints(aEndpoints);
+}
 void VDWebsocket::wsWrite(string msg)
 {
 
-	if (clientConnected) mClient.write(msg);
+	VDWebsocketSource *source = mSources[0].get();
+	post([source, msg]() {
+		if (source->connected) source->client->write(msg);
+	});
 
 }
 
 void VDWebsocket::sendJSON(string params) {
 
-	wsWrite(params);
+	mOutbox.raw(params);
 
 }
+void VDWebsocket::flush() {
+	if (mOutbox.empty()) return;
+	// one frame, one send, the builder keeps its buffer for the next frame
+	VDWebsocketSource *source = mSources[0].get();
+	string message = mOutbox.finish();
+	post([source, message]() {
+		if (source->connected) source->client->write(message);
+	});
+	mOutbox.clear();
+}
 void VDWebsocket::toggleAuto(unsigned int aIndex) {
 	// toggle
 	//mVDAnimation->toggleAuto(aIndex);
@@ -416,24 +1036,50 @@ void VDWebsocket::changeFloatValue(unsigned int aControl, float aValue, bool for
 }
 void VDWebsocket::changeShaderIndex(unsigned int aWarpIndex, unsigned int aWarpShaderIndex, unsigned int aSlot) {
 	//aSlot 0 = A, 1 = B,...
-	stringstream sParams;
-	sParams << "{\"cmd\" :[{\"type\" : 1,\"warp\" : " << aWarpIndex << ",\"shader\" : " << aWarpShaderIndex << ",\"slot\" : " << aSlot << "}]}";
-	string strParams = sParams.str();
-	sendJSON(strParams);
+	//{"cmd" :[{"type" : 1,"warp" : 0,"shader" : 2,"slot" : 0}]}
+	mOutbox.beginObject();
+	mOutbox.key("cmd");
+	mOutbox.beginArray();
+	mOutbox.beginObject();
+	mOutbox.key("type");
+	mOutbox.value(1);
+	mOutbox.key("warp");
+	mOutbox.value(aWarpIndex);
+	mOutbox.key("shader");
+	mOutbox.value(aWarpShaderIndex);
+	mOutbox.key("slot");
+	mOutbox.value(aSlot);
+	mOutbox.endObject();
+	mOutbox.endArray();
+	mOutbox.endObject();
 }
 void VDWebsocket::changeWarpFboIndex(unsigned int aWarpIndex, unsigned int aWarpFboIndex, unsigned int aSlot) {
 	//aSlot 0 = A, 1 = B,...
-	stringstream sParams;
-	sParams << "{\"cmd\" :[{\"type\" : 0,\"warp\" : " << aWarpIndex << ",\"fbo\" : " << aWarpFboIndex << ",\"slot\" : " << aSlot << "}]}";
-	string strParams = sParams.str();
-	sendJSON(strParams);
+	//{"cmd" :[{"type" : 0,"warp" : 0,"fbo" : 1,"slot" : 0}]}
+	mOutbox.beginObject();
+	mOutbox.key("cmd");
+	mOutbox.beginArray();
+	mOutbox.beginObject();
+	mOutbox.key("type");
+	mOutbox.value(0);
+	mOutbox.key("warp");
+	mOutbox.value(aWarpIndex);
+	mOutbox.key("fbo");
+	mOutbox.value(aWarpFboIndex);
+	mOutbox.key("slot");
+	mOutbox.value(aSlot);
+	mOutbox.endObject();
+	mOutbox.endArray();
+	mOutbox.endObject();
 }
 void VDWebsocket::changeFragmentShader(string aFragmentShaderText) {
-
-	stringstream sParams;
-	sParams << "{\"event\" : \"frag\",\"message\" : \"" << aFragmentShaderText << "\"}";
-	string strParams = sParams.str();
-	sendJSON(strParams);
+	// the shader text is escaped, quotes and newlines used to break the json
+	mOutbox.beginObject();
+	mOutbox.key("event");
+	mOutbox.value("frag");
+	mOutbox.key("message");
+	mOutbox.value(aFragmentShaderText);
+	mOutbox.endObject();
 }
 void VDWebsocket::colorWrite()
 {
@@ -458,9 +1104,29 @@ void VDWebsocket::colorWrite()
 }
 
 void VDWebsocket::update() {
-	if (clientConnected)
-	{
-		mClient.poll();
+	// a finished replay hands the input back to the socket
+	if (!mReplaying) joinReplay();
+	// the network thread and the replay deliver through the inbox
+	VDWebsocketEvent event;
+	while (mInbox.pop(event)) applyEvent(event);
+	if (!mNetworkThreaded && !mReplaying) {
+		// one poll serves every source, it also drives connecting and reconnecting
+		if (mIoService.stopped()) mIoService.reset();
+		mIoService.poll();
+		// everything parsed during this poll becomes one snapshot per source
+		for (auto &source : mSources) source->uniforms->publish();
 	}
-
+	// jittered sources are written here, a fixed delay behind the messages
+	uint64_t now = VDLatencyTracker::now();
+	for (auto &source : mSources) {
+		VDJitterBufferRef jitter = std::atomic_load(&source->jitter);
+		if (!jitter) continue;
+		jitter->playout(now, *source->uniforms);
+		source->uniforms->publish();
+	}
+	for (auto &source : mSources) {
+		source->uniformsChanged = source->uniforms->swap();
+		if (source->uniformsChanged) applied(VDLatencyTracker::UNIFORMS, source->uniforms->getSnapshot().received);
+	}
+	if (getElapsedSeconds() - mPingTime > kPingInterval) wsPing();
 }